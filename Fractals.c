@@ -9,13 +9,17 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
 #include <math.h>
 #include <string.h>
+#include <limits.h>
 #include "Fractals.h"
 #include "vecio.h"
 #include "matvec_read.h"
-#define DOTSIZE 1 //must be an odd positive integer
+#include "vecmath.h"
+#include "density.h"
+#include "render.h"
+#include "hutchinson.h"
+#include "fanout.h"
 
 double f(double *val, double point, double functype){
     /* This function is used to compute non-affine transformations
@@ -24,9 +28,9 @@ double f(double *val, double point, double functype){
      * functype, computed with a randomly generated value, val, 
      * stored in the IFS genome
      */
-    double newval;
+    double newval = 0;
     if (functype == 1){
-        newval = val[0]*tanh(val[1]*point);
+        newval = val[0]*cos(val[1]*point);
     }
     if (functype == 2){
         newval = val[0]*sin(val[1]*point);
@@ -120,69 +124,205 @@ void func(double *x, double *y, double **genome, int funcnum, double functype){
      *                10:   piecewise affine        new_x = {ax+by + c, x < 0
      *                                                       dx+ey + f, x >= 0
      *
+     * The parameters of the function are looked up in the genome on every
+     * call, which is O(numfuncs). Inner loops should compile the genome
+     * once with compilegenome() and use mapfunc() instead. functype is 
+     * kept for compatibility and must match genome[3][funcnum].
      */
-    double oldx = *x;
-    double oldy = *y;
+    struct FracMap map;
+    compilemap(&map, genome, funcnum);
+    mapfunc(x, y, &map);
+}
+
+double fkernel(double a, double b, double point, int kind){
+    /* This function is the same as f() but takes the parameters
+     * directly and the transformation type as an integer 
+     */
+    switch (kind){
+        case 1:  return a*cos(b*point);
+        case 2:  return a*sin(b*point);
+        case 3:  return a*tanh(b*point);
+        default: return 0;
+    }
+}
+
+void compilemap(struct FracMap *map, double **genome, int funcnum){
+    /* This function copies the parameters of the funcnumth function
+     * of a genome into a FracMap, so that the function can be applied
+     * without searching through the genome for where its parameters 
+     * start. For functypes 1 to 9, kindx and kindy are the f() types 
+     * used on x and y respectively.
+     */
+    int i;
+    int type = genome[3][funcnum];
     int ind = funcind(funcnum, genome);
     int addind = funcaddind(funcnum, genome);
-    if (functype == 0){
-        (*x) = genome[0][ind]   * oldx + genome[0][ind+1] * oldy + genome[1][addind];
-        (*y) = genome[0][ind+2] * oldx + genome[0][ind+3] * oldy + genome[1][addind+1];
+    map -> type = type;
+    map -> kindx = 0;
+    map -> kindy = 0;
+    if (type >= 1 && type <= 9){
+        map -> kindx = (type - 1)/3 + 1;
+        map -> kindy = (type - 1)%3 + 1;
     }
-    else if (functype == 1){
-        (*x) = f(&(genome[0][ind]), oldx, 1) + f(&(genome[0][ind+2]), oldy, 1) + genome[1][funcnum*2];
-        (*y) = f(&(genome[0][ind+4]), oldx, 1) + f(&(genome[0][ind+6]), oldy, 1) + genome[1][funcnum*2+1];
+    for (i = 0; i < 8; i++){
+        map -> m[i] = (i < multindjump(type)) ? genome[0][ind + i] : 0;
     }
-    else if (functype == 2){
-        (*x) = f(&(genome[0][ind]), oldx, 1) + f(&(genome[0][ind+2]), oldy, 2) + genome[1][funcnum*2];
-        (*y) = f(&(genome[0][ind+4]), oldx, 1) + f(&(genome[0][ind+6]), oldy, 2) + genome[1][funcnum*2+1];
+    for (i = 0; i < 4; i++){
+        map -> a[i] = (i < addindjump(type)) ? genome[1][addind + i] : 0;
     }
-    else if (functype == 3){
-        (*x) = f(&(genome[0][ind]), oldx, 1) + f(&(genome[0][ind+2]), oldy, 3) + genome[1][funcnum*2];
-        (*y) = f(&(genome[0][ind+4]), oldx, 1) + f(&(genome[0][ind+6]), oldy, 3) + genome[1][funcnum*2+1];
-    }
-    else if (functype == 4){
-        (*x) = f(&(genome[0][ind]), oldx, 2) + f(&(genome[0][ind+2]), oldy, 1) + genome[1][funcnum*2];
-        (*y) = f(&(genome[0][ind+4]), oldx, 2) + f(&(genome[0][ind+6]), oldy, 1) + genome[1][funcnum*2+1];
+    return;
+}
+
+void compilegenome(struct Fractal *frac){
+    /* This function compiles every function in the genome of a 
+     * fractal into frac -> maps, and its probabilities into an alias
+     * table (see buildalias). It has to be called again whenever
+     * the genome changes. NOTE: This function assumes that 
+     * initializefrac has been called
+     */
+    for (int i = 0; i < frac -> numfuncs; i++){
+        compilemap(&(frac -> maps[i]), frac -> genome, i);
     }
-    else if (functype == 5){
-        (*x) = f(&(genome[0][ind]), oldx, 2) + f(&(genome[0][ind+2]), oldy, 2) + genome[1][funcnum*2];
-        (*y) = f(&(genome[0][ind+4]), oldx, 2) + f(&(genome[0][ind+6]), oldy, 2) + genome[1][funcnum*2+1];
+    buildalias(frac -> numfuncs, frac -> genome[2], frac -> aliasprob, frac -> alias);
+    return;
+}
+
+void buildalias(int numfuncs, double *probs, double *aliasprob, int *alias){
+    /* This function builds an alias table (Vose's method) so that a 
+     * function can be picked with the probabilities in probs in constant
+     * time (see pickfunc). Each function i gets a column of height 1/numfuncs,
+     * filled to aliasprob[i] with i and the rest with alias[i]. Columns 
+     * taller than their share are cut down to fill the short ones.
+     */
+    int i, s, l, numsmall = 0, numlarge = 0;
+    int small[numfuncs], large[numfuncs];
+    double scaled[numfuncs], total = 0;
+    for (i = 0; i < numfuncs; i++) total += probs[i];
+    for (i = 0; i < numfuncs; i++){
+        scaled[i] = (total > 0) ? probs[i]*numfuncs/total : 1;
+        alias[i] = i;
+        if (scaled[i] < 1) small[numsmall++] = i;
+        else large[numlarge++] = i;
     }
-    else if (functype == 6){
-        (*x) = f(&(genome[0][ind]), oldx, 2) + f(&(genome[0][ind+2]), oldy, 3) + genome[1][funcnum*2];
-        (*y) = f(&(genome[0][ind+4]), oldx, 2) + f(&(genome[0][ind+6]), oldy, 3) + genome[1][funcnum*2+1];
+    while (numsmall > 0 && numlarge > 0){
+        s = small[--numsmall];
+        l = large[--numlarge];
+        aliasprob[s] = scaled[s];
+        alias[s] = l;
+        scaled[l] -= 1 - scaled[s];
+        if (scaled[l] < 1) small[numsmall++] = l;
+        else large[numlarge++] = l;
     }
-    else if (functype == 7){
-        (*x) = f(&(genome[0][ind]), oldx, 3) + f(&(genome[0][ind+2]), oldy, 1) + genome[1][funcnum*2];
-        (*y) = f(&(genome[0][ind+4]), oldx, 3) + f(&(genome[0][ind+6]), oldy, 1) + genome[1][funcnum*2+1];
+    while (numlarge > 0) aliasprob[large[--numlarge]] = 1;
+    while (numsmall > 0) aliasprob[small[--numsmall]] = 1;   //only left by rounding
+    return;
+}
+
+int pickfunc(struct Fractal *frac, double num){
+    /* This function picks a function of a fractal with the probabilities
+     * in genome[2], given a uniform random number num in [0, 1), using 
+     * the alias table made by compilegenome. With equal probabilities 
+     * it picks the same function as walking through genome[2] would.
+     */
+    double col = num * frac -> numfuncs;
+    int funcnum = (int)col;
+    if (funcnum >= frac -> numfuncs) funcnum = frac -> numfuncs - 1;
+    if (col - funcnum >= frac -> aliasprob[funcnum]) funcnum = frac -> alias[funcnum];
+    return funcnum;
+}
+
+double areafactor(struct FracMap *map, double *window){
+    /* This function estimates how much a compiled function shrinks 
+     * areas, ie. |det| of its Jacobian. This is exact for affine maps 
+     * and the average of the two halves for piecewise affine maps. For 
+     * the trig maps (functypes 1 to 9) the Jacobian changes from point 
+     * to point, so |det| is averaged over an 8x8 grid of points spread 
+     * over the viewing window.
+     */
+    int i, j;
+    double *m = map -> m;
+    double x, y, fx[2], fy[2], det, sum = 0;
+    if (map -> type == 0) return fabs(funcdeterminant(m[0], m[1], m[2], m[3]));
+    if (map -> type == 10){
+        return (fabs(funcdeterminant(m[0], m[1], m[2], m[3])) + fabs(funcdeterminant(m[4], m[5], m[6], m[7])))/2;
     }
-    else if (functype == 8){
-        (*x) = f(&(genome[0][ind]), oldx, 3) + f(&(genome[0][ind+2]), oldy, 2) + genome[1][funcnum*2];
-        (*y) = f(&(genome[0][ind+4]), oldx, 3) + f(&(genome[0][ind+6]), oldy, 2) + genome[1][funcnum*2+1];
+    for (i = 0; i < 8; i++){
+        for (j = 0; j < 8; j++){
+            x = window[0] + (window[1] - window[0])*(i + 0.5)/8;
+            y = window[2] + (window[3] - window[2])*(j + 0.5)/8;
+            for (int k = 0; k < 2; k++){
+                //derivatives of a*f(b*x) for the x and y kernels of row k
+                double bx = m[4*k+1]*x, by = m[4*k+3]*y;
+                fx[k] = m[4*k]*m[4*k+1]*((map -> kindx == 1) ? -sin(bx) : (map -> kindx == 2) ? cos(bx) : 1 - tanh(bx)*tanh(bx));
+                fy[k] = m[4*k+2]*m[4*k+3]*((map -> kindy == 1) ? -sin(by) : (map -> kindy == 2) ? cos(by) : 1 - tanh(by)*tanh(by));
+            }
+            det = fx[0]*fy[1] - fy[0]*fx[1];
+            sum += fabs(det);
+        }
     }
-    else if (functype == 9){
-        (*x) = f(&(genome[0][ind]), oldx, 3) + f(&(genome[0][ind+2]), oldy, 3) + genome[1][funcnum*2];
-        (*y) = f(&(genome[0][ind+4]), oldx, 3) + f(&(genome[0][ind+6]), oldy, 3) + genome[1][funcnum*2+1];
+    return sum/64;
+}
+
+void weightprobs(struct Fractal *frac){
+    /* This function sets the probabilities in genome[2] in proportion 
+     * to the area factor of each function (see areafactor), but at least
+     * MINPROBWEIGHT, so that functions that cover more of the attractor
+     * get more points and every pixel gets about the same number of 
+     * points. Small functions would otherwise keep lighting the same 
+     * few pixels while large ones are still sparse. The trig maps fold
+     * the plane over onto itself, so their images cover less than their
+     * area factor suggests, and they are weighted by its square root,
+     * which lights more pixels per point in practice.
+     */
+    int i;
+    double total = 0, *probs = frac -> genome[2];
+    for (i = 0; i < frac -> numfuncs; i++){
+        compilemap(&(frac -> maps[i]), frac -> genome, i);
+        probs[i] = areafactor(&(frac -> maps[i]), frac -> window);
+        if (frac -> maps[i].type >= 1 && frac -> maps[i].type <= 9) probs[i] = sqrt(probs[i]);
+        if (!(probs[i] > MINPROBWEIGHT)) probs[i] = MINPROBWEIGHT;
+        total += probs[i];
     }
-    else if (functype == 10){
-        if (piecewisecond(oldx, oldy)) {
-            (*x) = genome[0][ind]   * oldx + genome[0][ind+1] * oldy + genome[1][addind];
-            (*y) = genome[0][ind+2] * oldx + genome[0][ind+3] * oldy + genome[1][addind+1];
-        }
-        else {        
-            (*x) = genome[0][ind+4] * oldx + genome[0][ind+5] * oldy + genome[1][addind+2];
-            (*y) = genome[0][ind+6] * oldx + genome[0][ind+7] * oldy + genome[1][addind+3];
-        }
+    for (i = 0; i < frac -> numfuncs; i++) probs[i] /= total;
+    return;
+}
+
+void mapfunc(double *x, double *y, struct FracMap *map){
+    /* This function computes the transformation of a point (x, y) by a
+     * compiled IFS function. See func() for the function types
+     */
+    double oldx = *x;
+    double oldy = *y;
+    double *m = map -> m;
+    double *a = map -> a;
+    switch (map -> type){
+        case 0:
+            (*x) = m[0] * oldx + m[1] * oldy + a[0];
+            (*y) = m[2] * oldx + m[3] * oldy + a[1];
+            break;
+        case 10:
+            if (piecewisecond(oldx, oldy)) {
+                (*x) = m[0] * oldx + m[1] * oldy + a[0];
+                (*y) = m[2] * oldx + m[3] * oldy + a[1];
+            }
+            else {
+                (*x) = m[4] * oldx + m[5] * oldy + a[2];
+                (*y) = m[6] * oldx + m[7] * oldy + a[3];
+            }
+            break;
+        default:
+            (*x) = fkernel(m[0], m[1], oldx, map -> kindx) + fkernel(m[2], m[3], oldy, map -> kindy) + a[0];
+            (*y) = fkernel(m[4], m[5], oldx, map -> kindx) + fkernel(m[6], m[7], oldy, map -> kindy) + a[1];
+            break;
     }
 }
 
-double validranddouble(double functype){
+double validranddouble(struct FracRNG *rng, double functype){
     /* This function generates random values
      * within a specific range for IFS parameters
      */
-    double min;
-    double range;
+    double min = -1.;
+    double range = 2.;
     // for most parameters:
     if (functype >= 0) {
         min = -1.;
@@ -193,15 +333,15 @@ double validranddouble(double functype){
         min = 1.;
         range = 4.;
     }
-    double val = (double)rand()/RAND_MAX*range + min;
+    double val = rnguniform(rng)*range + min;
     if (functype == -1){
-        min = (double)rand()/RAND_MAX; 
+        min = rnguniform(rng);
         if (min < 0.5) val *= -1.;
     }
     return val;
 }
 
-void generatemults(double **genome, double functype, int *multparams){
+void generatemults(struct FracRNG *rng, double **genome, double functype, int *multparams){
     /* This function generates the multiplicative parameters 
      * of each function in an IFS. ie., the parameters that are not
      * the +c or +e in the functions defined in the func() function
@@ -220,7 +360,7 @@ void generatemults(double **genome, double functype, int *multparams){
     if (functype == 0){
         while (pass != 0){
             for (int j = i; j < i + 4; j++){
-                genome[0][j] = validranddouble(functype);
+                genome[0][j] = validranddouble(rng, functype);
             }
             pass = validatefunc(genome[0][i], genome[0][i+1], genome[0][i+2], genome[0][i+3]);
         }
@@ -229,26 +369,26 @@ void generatemults(double **genome, double functype, int *multparams){
     else if (functype < 10){
         while (pass != 0){
             for (int j = 0; j < 4; j++){
-                genome[0][i + 2*j] = validranddouble(functype);
+                genome[0][i + 2*j] = validranddouble(rng, functype);
             }
             pass = validatefunc(genome[0][i], genome[0][i+2], genome[0][i+4], genome[0][i+6]);
         }
         for (int j = 0; j < 4; j++){
-            genome[0][i + 2*j+1] = validranddouble(-1);
+            genome[0][i + 2*j+1] = validranddouble(rng, -1);
         }
         pass = 1;
     }
     else if (functype == 10){
         while (pass != 0){
             for (int j = i; j < i + 4; j++){
-                genome[0][j] = validranddouble(functype);
+                genome[0][j] = validranddouble(rng, functype);
             }
             pass = validatefunc(genome[0][i], genome[0][i+1], genome[0][i+2], genome[0][i+3]);
         }
         pass = 1;
         while (pass != 0){
             for (int j = i+4; j < i + 8; j++){
-                genome[0][j] = validranddouble(functype);
+                genome[0][j] = validranddouble(rng, functype);
             }
             pass = validatefunc(genome[0][i+4], genome[0][i+5], genome[0][i+6], genome[0][i+7]);
         }
@@ -258,7 +398,106 @@ void generatemults(double **genome, double functype, int *multparams){
     return;
 }
 
-void generateadds(double **genome, double functype, int *addparams){
+void drawcontraction(struct FracRNG *rng, double *m, int stride, double minscale, double maxscale){
+    /* This function draws a 2x2 matrix [m[0] m[stride]; m[2*stride] m[3*stride]]
+     * that is a contraction, without any retries. It is built from its 
+     * singular value decomposition, R(theta) diag(s1, s2) R(phi), with 
+     * the rotation angles uniform, s1 and s2 uniform in [minscale, maxscale)
+     * (or equal to minscale if it is maxscale) and the sign of s2 random so
+     * that half of the matrices are reflections. The range must be below 1
+     * (see --scales in setoption), so the largest singular value is below 1
+     * and the matrix is a contraction, as validatefunc checks for the 
+     * matrices drawn by generatemults.
+     */
+    double theta = 2*M_PI*rnguniform(rng);
+    double phi   = 2*M_PI*rnguniform(rng);
+    double s1 = minscale + (maxscale - minscale)*rnguniform(rng);
+    double s2 = minscale + (maxscale - minscale)*rnguniform(rng);
+    double ct = cos(theta), st = sin(theta), cp = cos(phi), sp = sin(phi);
+    if (s1 >= maxscale && minscale < maxscale) s1 = nextafter(maxscale, minscale);  //rounded up to maxscale
+    if (s2 >= maxscale && minscale < maxscale) s2 = nextafter(maxscale, minscale);
+    if (rnguniform(rng) < 0.5) s2 = -s2;
+    m[0]        = ct*s1*cp - st*s2*sp;
+    m[stride]   = -ct*s1*sp - st*s2*cp;
+    m[2*stride] = st*s1*cp + ct*s2*sp;
+    m[3*stride] = -st*s1*sp + ct*s2*cp;
+    return;
+}
+
+void generatemultsdirect(struct FracRNG *rng, double **genome, double functype, int *multparams, 
+                         double minscale, double maxscale){
+    /* This function generates the same multiplicative parameters as 
+     * generatemults, but draws the contractive 2x2 blocks directly with 
+     * drawcontraction instead of retrying until validatefunc accepts 
+     * them, so it always takes the same number of random numbers
+     */
+    int i = *multparams;
+    if (functype == 0){
+        drawcontraction(rng, &(genome[0][i]), 1, minscale, maxscale);
+        *multparams += 4;
+        return;
+    }
+    if (functype < 10){
+        drawcontraction(rng, &(genome[0][i]), 2, minscale, maxscale);
+        for (int j = 0; j < 4; j++){
+            genome[0][i + 2*j+1] = validranddouble(rng, -1);
+        }
+    }
+    else {
+        drawcontraction(rng, &(genome[0][i]), 1, minscale, maxscale);
+        drawcontraction(rng, &(genome[0][i+4]), 1, minscale, maxscale);
+    }
+    *multparams += 8;
+    return;
+}
+
+int allowedtypes(int *restrictions, int numrestrictions, int *allowed){
+    /* This function puts the function types that aren't restricted 
+     * into allowed, in order, and returns how many there are
+     */
+    int i, j, num = 0, restricted;
+    for (i = 0; i < NUMFUNCTYPES; i++){
+        restricted = 0;
+        for (j = 0; j < numrestrictions; j++){
+            if (i == restrictions[j]) restricted = 1;
+        }
+        if (restricted == 0) allowed[num++] = i;
+    }
+    return num;
+}
+
+void generatetypes(struct Fractal *frac, int *restrictions, int numrestrictions, int disperse){
+    /* This function picks the function types of a genome, in genome[3],
+     * the same way generategenome does (see it for disperse) but from a 
+     * table of the allowed types, so no type is ever drawn and thrown away.
+     * With disperse 1 the second type is drawn from the allowed types 
+     * other than the first.
+     */
+    int i, k, premade = 0, numallowed, allowed[NUMFUNCTYPES];
+    double *types = frac -> genome[3];
+    numallowed = allowedtypes(restrictions, numrestrictions, allowed);
+    if (numallowed < 1 || (disperse == 1 && numallowed < 2)){
+        fprintf(stderr, "Error, too many function types are restricted\n");
+        exit(1);
+    }
+    if (disperse == 1 && frac -> numfuncs >= 2){
+        k = rngint(&(frac -> rng), numallowed);
+        types[0] = allowed[k];
+        i = rngint(&(frac -> rng), numallowed - 1);
+        types[1] = allowed[(i >= k) ? i + 1 : i];
+        premade = 2;
+    }
+    if (disperse == 2){
+        for (i = 0; i < numallowed && i < frac -> numfuncs; i++) types[i] = allowed[i];
+        premade = i;
+    }
+    for (i = premade; i < frac -> numfuncs; i++){
+        types[i] = allowed[rngint(&(frac -> rng), numallowed)];
+    }
+    return;
+}
+
+void generateadds(struct FracRNG *rng, double **genome, double functype, int *addparams){
     /* This function generates the additive parameters
      * for each function in the IFS. ie., the +c or +e in the 
      * functions defined in the func() function.
@@ -273,7 +512,7 @@ void generateadds(double **genome, double functype, int *addparams){
     else numparams = 4;
 
     for (i = *addparams; i < *addparams + numparams; i++){
-        genome[1][i] = (double)rand()/RAND_MAX*2. - 1.;
+        genome[1][i] = rnguniform(rng)*2. - 1.;
     }
     *addparams += numparams;
     return;
@@ -283,6 +522,7 @@ void generategenome(struct Fractal *frac, int *restrictions, int numrestrictions
     /* This function generates the genome of a fractal, ie., the set of vectors that  
      * that contains all the parameters used to generate the fractal. 
      * NOTE: This function assumes that initializefrac has been called
+     * and uses the fractal's random number generator, frac -> rng
      *
      * INPUTS:
      *      frac            - the fractal struct for which the genome is being 
@@ -306,20 +546,36 @@ void generategenome(struct Fractal *frac, int *restrictions, int numrestrictions
      *                        each type.
      *                     2: this option will enforce that at least one of each 
      *                        function type will be in the resulting fractal.
+     *
+     * With frac -> sampler set to SAMPLERDIRECT the types are picked by 
+     * generatetypes and the functions drawn by generatemultsdirect, which
+     * need no retries, instead of the loops below.
      */
     int i, j;
     int multparams = 0;
     int addparams = 0;
     int pass = 1;
     int premade = 0;
-    int numfunctypes = 11;
+    int numfunctypes = NUMFUNCTYPES;
     double **genome = frac -> genome;
+    if (frac -> sampler == SAMPLERDIRECT){
+        generatetypes(frac, restrictions, numrestrictions, disperse);
+        dsortvec(frac -> numfuncs, genome[3]);
+        for (i = 0; i < frac -> numfuncs; i++){
+            generatemultsdirect(&(frac -> rng), genome, genome[3][i], &multparams, 
+                                frac -> minscale, frac -> maxscale);
+            generateadds(&(frac -> rng), genome, genome[3][i], &addparams);
+            genome[2][i] = 1./(double)frac -> numfuncs;
+        }
+        if (frac -> probpolicy == PROBSCONTRACTION) weightprobs(frac);
+        return;
+    }
     if (disperse == 1) {
         premade = 2;
         for (i = 0; i < 2; i++){
             while (pass != 0){
                 pass = 0;
-                genome[3][i] = rand()%numfunctypes;
+                genome[3][i] = rngint(&(frac -> rng), numfunctypes);
                 for (j = 0; j < numrestrictions; j++){
                     if (genome[3][i] == restrictions[j]) pass = 1;
                     if ((i == 1) && (genome[3][i] == genome[3][i-1])) pass = 1;
@@ -343,7 +599,7 @@ void generategenome(struct Fractal *frac, int *restrictions, int numrestrictions
     for (i = premade; i < frac -> numfuncs; i++){
         while (pass != 0){ 
             pass = 0;
-            genome[3][i] = rand()%numfunctypes;
+            genome[3][i] = rngint(&(frac -> rng), numfunctypes);
             for (j = 0; j < numrestrictions; j++){
                 if (genome[3][i] == restrictions[j]) pass = 1;
             }
@@ -352,10 +608,11 @@ void generategenome(struct Fractal *frac, int *restrictions, int numrestrictions
     }
     dsortvec(frac -> numfuncs, genome[3]);
     for (i = 0; i < frac -> numfuncs; i++){
-        generatemults(genome, genome[3][i], &multparams);
-        generateadds(genome, genome[3][i], &addparams);
+        generatemults(&(frac -> rng), genome, genome[3][i], &multparams);
+        generateadds(&(frac -> rng), genome, genome[3][i], &addparams);
         genome[2][i] = 1./(double)frac -> numfuncs;
     }
+    if (frac -> probpolicy == PROBSCONTRACTION) weightprobs(frac);
     return;
 }
 
@@ -466,58 +723,215 @@ void initializefrac(struct Fractal *frac, int numfuncs, int numpoints){
     /* This function initializes a fractal structure. The number of
      * points and number of functions has to be defined before it 
      * can be called. This function then allocates memory for the
-     * x and y points that will be generated as well as allocating 
-     * memory for the matrix representing the picture of the fractal.
+     * matrix representing the picture of the fractal. The x and y 
+     * points are not kept by default, since each point is put in the
+     * matrix as soon as it is generated (see generatefrac). Set 
+     * frac -> keeppoints to 1 before calling generatefrac to also 
+     * keep them in xs, ys and colours.
      *
      * All values corresponding to the fractal other than numfuncs,
      * numpoints, and whether the fractal is colours or not
-     * are initialized to -1
+     * are initialized to -1 (see resetfrac)
+     *
+     * A fractal structure can be used for any number of fractals
+     * with the same numfuncs and numpoints, one after the other,
+     * without allocating memory again.
+     *
+     * The pixel map is HEIGHT x WIDTH, use resizefrac to change it.
      */
-    int i;
-    frac -> fracnum   = -1;
     frac -> numfuncs  = numfuncs;
     frac -> numpoints = numpoints;
-    frac -> numb      = -1;
-    frac -> avgx      = -1;
-    frac -> avgy      = -1;
-    frac -> stddevx   = -1;
-    frac -> stddevy   = -1;
-    frac -> dimension = -1;
-    frac -> dist      = -1;
+    resetfrac(frac);
     frac -> coloured  = 1; //dont colour fractals by function by default
                            //to make them coloured by function by default
                            //change this to 0
+    frac -> numwalkers = NUMWALKERS; //independent orbits followed at once,
+                                     //1 follows a single orbit
+    frac -> renderthreads = 1;       //threads plotting the points of one fractal,
+                                     //see render.c
+    frac -> probpolicy = PROBSEQUAL;     //change this to PROBSCONTRACTION to pick functions
+                                         //in proportion to their area (see weightprobs)
+    frac -> sampler = SAMPLERREJECT; //change this to SAMPLERDIRECT to draw contractive
+    frac -> minscale = 0;            //functions directly, with singular values
+    frac -> maxscale = 1;            //in [minscale, maxscale)
+    frac -> kernels = KERNELVEC;     //how walkers evaluate cos, sin and tanh, change
+                                     //this to KERNELFAST for faster approximations
+                                     //or KERNELLIBM for libm (see walkerstep)
+    rngseed(&(frac -> rng), 0, 0);   //reseed with the run's seed and the 
+                                     //fractal number, see makerandfrac
+    frac -> keeppoints = 0;
+    frac -> adaptive   = 0;              //set to 1 to stop once new pixels run out,
+    frac -> minpoints  = numpoints/10;   //but not before minpoints points, checking
+    frac -> pointbatch = POINTBATCH;     //every pointbatch points for fewer than
+    frac -> mincoverage = MINCOVERAGE;   //mincoverage new pixels per point
+    frac -> pilot = NULL;                //limits for pilot renders, see fillrandfrac
+    frac -> health = 0;                  //set to 1 to check each orbit with checkorbit
+    frac -> burnin = BURNIN;             //first, which also sizes the burn-in
+    frac -> window[0] = -1;
+    frac -> window[1] =  1;
+    frac -> window[2] = -1;
+    frac -> window[3] =  1;
+    frac -> width  = WIDTH;
+    frac -> height = HEIGHT;
+    frac -> numviews = 0;                //extra images, see addview
+    frac -> views  = NULL;
+    frac -> density = NULL;              //set to a histogram (see newdensity) to
+                                         //count the points on each pixel as well
+    frac -> engine = ENGINECHAOS;        //change this to ENGINESET to iterate the 
+    frac -> supersample = 0;             //Hutchinson operator instead (see hutchinson.c)
+    frac -> set = NULL;                  //or to ENGINEFANOUT to fan out from seeds
+    frac -> fandepth = 0;                //through compositions of the functions (see fanout.c)
+    frac -> fan = NULL;
 
     /* initialize genome */
     double **genome = mallocgenome(numfuncs);
     frac -> genome = genome;
+    if ((frac -> maps = (struct FracMap *)malloc(numfuncs * sizeof(struct FracMap))) == NULL){
+        fprintf(stderr, "Malloc Failed. (initialize maps)\n");
+        exit(1);
+    }
+    if (((frac -> aliasprob = (double *)malloc(numfuncs * sizeof(double))) == NULL)||
+        ((frac -> alias = (int *)malloc(numfuncs * sizeof(int))) == NULL)){
+        fprintf(stderr, "Malloc Failed. (initialize alias table)\n");
+        exit(1);
+    }
+    if ((frac -> stats.funccounts = (int *)calloc(numfuncs, sizeof(int))) == NULL){
+        fprintf(stderr, "Malloc Failed. (initialize stats)\n");
+        exit(1);
+    }
 
-    /* initialize xs, ys, and colour vector*/
-    if ((frac -> xs = (double *)malloc(numpoints * sizeof(double))) == NULL){
-        fprintf(stderr, "Malloc Failed. (initialize points)\n");
+    /* xs, ys, and colours are allocated by allocpoints if they are kept */
+    frac -> xs = NULL;
+    frac -> ys = NULL;
+    frac -> colours = NULL;
+
+    /* initizlize the pixel map, one byte per pixel, row by row */
+    if (numfuncs >= BLANKPIXEL){
+        fprintf(stderr, "Too many functions for the pixel map (%d, max %d)\n", numfuncs, BLANKPIXEL-1);
         exit(1);
     }
-    if ((frac -> ys = (double *)malloc(numpoints * sizeof(double))) == NULL){
-        fprintf(stderr, "Malloc Failed. (initialize points)\n");
+    frac -> bm = NULL;
+    frac -> boxes = NULL;
+    frac -> lastchunk = NULL;            //only used by the workers in render.c
+    resizefrac(frac, WIDTH, HEIGHT);
+    return;
+}
+
+void resizefrac(struct Fractal *frac, int width, int height){
+    /* This function (re)allocates the pixel map of a fractal, and the 
+     * scratch space for box counting, for a width x height image.
+     * Both must be at least MINRES, and pixels are indexed with ints.
+     */
+    if (frac -> bm != NULL && frac -> width == width && frac -> height == height) return;
+    if (width < MINRES || height < MINRES || (long long)width*height > INT_MAX){
+        fprintf(stderr, "Unsupported resolution %dx%d (resizefrac)\n", width, height);
+        exit(1);
+    }
+    free(frac -> bm);
+    free(frac -> boxes);
+    frac -> width  = width;
+    frac -> height = height;
+    if (frac -> density != NULL) resizedensity(frac -> density, width, height);
+    if ((frac -> bm = (unsigned char *)malloc((size_t)height*width*sizeof(unsigned char))) == NULL){
+        fprintf(stderr, "Malloc Failed. (makematrix)\n");
+        exit(1);
+    }
+    if ((frac -> boxes = (unsigned char *)malloc((size_t)((height+1)/2)*((width+1)/2)*sizeof(unsigned char))) == NULL){
+        fprintf(stderr, "Malloc Failed. (makematrix)\n");
         exit(1);
     }
-    if ((frac -> colours = (int *)malloc(numpoints * sizeof(int))) == NULL){
+    return;
+}
+
+void addview(struct Fractal *frac, int width, int height, double *window){
+    /* This function adds an extra width x height image of a fractal 
+     * with the viewing window given (or frac -> window if window is NULL,
+     * as it is when the fractal is generated). Views are drawn from the 
+     * same points as the pixel map, so a fractal can be drawn at several
+     * resolutions or windows while only generating its points once.
+     * Views only hold pixels, the stats are of the pixel map.
+     */
+    struct FracView *view;
+    if (width < MINRES || height < MINRES || (long long)width*height > INT_MAX){
+        fprintf(stderr, "Unsupported resolution %dx%d (addview)\n", width, height);
+        exit(1);
+    }
+    if (frac -> numviews >= MAXVIEWS){
+        fprintf(stderr, "Too many views (max %d)\n", MAXVIEWS);
+        exit(1);
+    }
+    if (frac -> views == NULL && 
+        (frac -> views = (struct FracView *)malloc(MAXVIEWS*sizeof(struct FracView))) == NULL){
+        fprintf(stderr, "Malloc Failed. (addview)\n");
+        exit(1);
+    }
+    view = &(frac -> views[frac -> numviews]);
+    view -> width  = width;
+    view -> height = height;
+    view -> samewindow = (window == NULL);
+    for (int i = 0; i < 4; i++) view -> window[i] = (window != NULL) ? window[i] : frac -> window[i];
+    if ((view -> bm = (unsigned char *)malloc((size_t)height*width*sizeof(unsigned char))) == NULL){
+        fprintf(stderr, "Malloc Failed. (addview)\n");
+        exit(1);
+    }
+    view -> lastchunk = NULL;
+    frac -> numviews++;
+    return;
+}
+
+void allocpoints(struct Fractal *frac){
+    /* This function allocates xs, ys and colours for 
+     * numpoints points, if they aren't already 
+     */
+    if (frac -> xs != NULL) return;
+    if ((frac -> xs = (double *)malloc(frac -> numpoints * sizeof(double))) == NULL){
         fprintf(stderr, "Malloc Failed. (initialize points)\n");
         exit(1);
     }
-    /* initizlize the pixel map */
-    int **bm;
-    if ((bm = (int **)malloc(HEIGHT*sizeof(int *))) == NULL){
-        fprintf(stdout, "Malloc Failed. (makematrix)\n");
+    if ((frac -> ys = (double *)malloc(frac -> numpoints * sizeof(double))) == NULL){
+        fprintf(stderr, "Malloc Failed. (initialize points)\n");
         exit(1);
     }
-    for (i = 0; i < HEIGHT; i++){
-        if ((bm[i] = (int *)malloc(WIDTH*sizeof(int))) == NULL){
-            fprintf(stderr, "Malloc Failed. (makematrix)\n");
-            exit(1);
-        }
+    if ((frac -> colours = (int *)malloc(frac -> numpoints * sizeof(int))) == NULL){
+        fprintf(stderr, "Malloc Failed. (initialize points)\n");
+        exit(1);
     }
-    frac -> bm = bm;
+    return;
+}
+
+int stopearly(struct Fractal *frac, int numdone, int *lastnumb){
+    /* This function is called after every pointbatch points while
+     * generating the points of a fractal. If adaptive is set, it 
+     * returns 1 when the last batch of points lit at most 
+     * mincoverage new pixels per point, ie. the attractor is 
+     * already filled in and more points won't change its image.
+     * With mincoverage 0 a whole batch has to light no new pixels,
+     * though the chaos game can still find a rare pixel after that
+     * (see README). Generation never stops before minpoints points.
+     */
+    int newpixels = frac -> stats.numb - *lastnumb;
+    *lastnumb = frac -> stats.numb;
+    if (frac -> adaptive == 0 || numdone < frac -> minpoints) return 0;
+    return (newpixels <= frac -> mincoverage * frac -> pointbatch);
+}
+
+void resetfrac(struct Fractal *frac){
+    /* This function resets the values calculated for a fractal
+     * to -1 so that the fractal structure can be reused for a 
+     * new fractal. Nothing is allocated or freed.
+     */
+    frac -> fracnum   = -1;
+    frac -> numb      = -1;
+    frac -> avgx      = -1;
+    frac -> avgy      = -1;
+    frac -> stddevx   = -1;
+    frac -> stddevy   = -1;
+    frac -> dimension = -1;
+    frac -> dimfit    = -1;
+    frac -> dist      = -1;
+    frac -> pointsused = -1;
+    frac -> contraction = -1;
+    frac -> lipschitz  = -1;
     return;
 }
 
@@ -528,44 +942,157 @@ double generatepoints(struct Fractal *frac){
      * point. A new function is then picked and transforms 
      * the output from the last point. This continues until
      * numpoints points are generated. Additionally, the 
-     * first 100 points are thrown away to ensure that all 
+     * first frac -> burnin points (BURNIN, or as sized by 
+     * checkorbit) are thrown away to ensure that all 
      * (or close to all) points correspond to the fractal. 
+     *
+     * Each point is put into the pixel map as it is generated
+     * (see plotpoint), and is only stored in xs, ys and colours
+     * if frac -> keeppoints is set. If frac -> adaptive is set,
+     * generation can stop before numpoints (see stopearly). The
+     * number of points generated is stored in frac -> pointsused.
      */
     int i,j;
+    int lastnumb = 0;
+    int nextcheck = frac -> pointbatch;
     int funcnum;
-    double p, num;
     double max = 0;
-    double x = (double)rand()/RAND_MAX; 
-    double y = (double)rand()/RAND_MAX;
-    double maxx = 0;
-    double maxy = 0;
-    for (i = 0; i < 100; i++){
-        funcnum = rand()%frac -> numfuncs;
-        func(&x, &y, frac -> genome, funcnum, frac -> genome[3][funcnum]);
+    struct FracRNG *rng = &(frac -> rng);
+    double x = rnguniform(rng);
+    double y = rnguniform(rng);
+    struct FracMap *maps = frac -> maps;
+    for (i = 0; i < frac -> burnin; i++){
+        funcnum = rngint(rng, frac -> numfuncs);
+        mapfunc(&x, &y, &(maps[funcnum]));
     }
     for (i = 0; i < frac -> numpoints; i++){
-        num = (double)rand()/RAND_MAX;
-        p = 0.0;
-        funcnum = 0;
-        for (j = 0; j < frac -> numfuncs; j++){
-            p += frac -> genome[2][j];
-            if (num < p) {
-                func(&x,&y,frac -> genome, funcnum, frac -> genome[3][j]);
-                frac -> xs[i] = x;
-                frac -> ys[i] = y;
-                
-                //note: colours get put to pixels in generatebm (below)
-                //      and colours chosen are in PNGio.c
-                frac -> colours[i] = funcnum;
-                if (fabs(x) > max) max = fabs(x);
-                if (fabs(y) > max) max = fabs(y);
-                if (fabs(x) > maxx) maxx = fabs(x);
-                if (fabs(y) > maxy) maxy = fabs(y);
-                break;
+        if (i >= nextcheck){
+            if (stopearly(frac, i, &lastnumb)) break;
+            nextcheck += frac -> pointbatch;
+        }
+        funcnum = pickfunc(frac, rnguniform(rng));
+        mapfunc(&x, &y, &(maps[funcnum]));
+        //note: colours get put to pixels in plotpoint (below)
+        //      and colours chosen are in PNGio.c
+        plotpoint(frac, x, y, funcnum);
+        for (j = 0; j < frac -> numviews; j++) plotview(&(frac -> views[j]), x, y, funcnum);
+        if (frac -> keeppoints){
+            frac -> xs[i] = x;
+            frac -> ys[i] = y;
+            frac -> colours[i] = funcnum;
+        }
+        if (fabs(x) > max) max = fabs(x);
+        if (fabs(y) > max) max = fabs(y);
+    }
+    frac -> pointsused = i;
+    return max;
+}
+
+void walkerstep(int numw, double *x, double *y, int *funcnums, struct FracMap *maps, int kernels){
+    /* This function moves numw independent walkers one step, walker w
+     * being transformed by the function maps[funcnums[w]]. 
+     *
+     * Affine and piecewise walkers are done directly. For the trig 
+     * walkers (functypes 1 to 9), the 4 arguments b*x or b*y of each 
+     * walker are gathered into one vector per kernel, cos, sin or tanh,
+     * and each vector is evaluated at once with vcos()/vsin()/vtanh() 
+     * (see vecmath.c) which the compiler vectorizes. The results are 
+     * then scattered back to the walkers. With kernels KERNELFAST the 
+     * faster, less accurate, versions are used (eg. vcosfast()), and 
+     * with KERNELLIBM every walker is done with mapfunc() instead.
+     */
+    int w, j, n[4], kind, trig = 0;
+    double args[4*4*MAXWALKERS], vals[4*4*MAXWALKERS], v[4];
+    int slot[4][MAXWALKERS];
+    struct FracMap *map;
+    n[1] = n[2] = n[3] = 0;
+    for (w = 0; w < numw; w++){
+        map = &(maps[funcnums[w]]);
+        if (map -> type >= 1 && map -> type <= 9 && kernels != KERNELLIBM){
+            for (j = 0; j < 4; j++){
+                kind = (j%2 == 0) ? map -> kindx : map -> kindy;
+                slot[j][w] = kind*4*MAXWALKERS + n[kind];
+                args[slot[j][w]] = map -> m[2*j+1] * ((j%2 == 0) ? x[w] : y[w]);
+                n[kind]++;
+            }
+            trig = 1;
+        }
+        else mapfunc(&(x[w]), &(y[w]), map);
+    }
+    if (trig == 0) return;
+    if (kernels == KERNELFAST){
+        vcosfast(n[1],  &(vals[4*MAXWALKERS]),   &(args[4*MAXWALKERS]));
+        vsinfast(n[2],  &(vals[2*4*MAXWALKERS]), &(args[2*4*MAXWALKERS]));
+        vtanhfast(n[3], &(vals[3*4*MAXWALKERS]), &(args[3*4*MAXWALKERS]));
+    }
+    else {
+        vcos(n[1],  &(vals[4*MAXWALKERS]),   &(args[4*MAXWALKERS]));
+        vsin(n[2],  &(vals[2*4*MAXWALKERS]), &(args[2*4*MAXWALKERS]));
+        vtanh(n[3], &(vals[3*4*MAXWALKERS]), &(args[3*4*MAXWALKERS]));
+    }
+    for (w = 0; w < numw; w++){
+        map = &(maps[funcnums[w]]);
+        if (map -> type >= 1 && map -> type <= 9){
+            for (j = 0; j < 4; j++){
+                v[j] = map -> m[2*j] * vals[slot[j][w]];
             }
-            else funcnum ++;
+            x[w] = v[0] + v[1] + map -> a[0];
+            y[w] = v[2] + v[3] + map -> a[1];
+        }
+    }
+    return;
+}
+
+double generatewalkers(struct Fractal *frac){
+    /* This function generates the points corresponding to a 
+     * fractal in the same way as generatepoints(), except that 
+     * frac -> numwalkers orbits are followed at once (see walkerstep).
+     * Each walker starts at its own random point and throws away
+     * its own first frac -> burnin points. The walkers then take turns filling
+     * xs, ys and colours, so the same number of points is generated. 
+     */
+    int i, j, w;
+    int lastnumb = 0;
+    int nextcheck = frac -> pointbatch;
+    int numw = frac -> numwalkers;
+    int numfuncs = frac -> numfuncs;
+    double max = 0;
+    double x[MAXWALKERS], y[MAXWALKERS];
+    int funcnums[MAXWALKERS];
+    struct FracRNG *rng = &(frac -> rng);
+    if (numw > MAXWALKERS) numw = MAXWALKERS;
+    for (w = 0; w < numw; w++){
+        x[w] = rnguniform(rng);
+        y[w] = rnguniform(rng);
+    }
+    for (i = 0; i < frac -> burnin; i++){
+        for (w = 0; w < numw; w++){
+            funcnums[w] = rngint(rng, numfuncs);
         }
+        walkerstep(numw, x, y, funcnums, frac -> maps, frac -> kernels);
     }
+    for (i = 0; i < frac -> numpoints; i += numw){
+        if (i >= nextcheck){
+            if (stopearly(frac, i, &lastnumb)) break;
+            nextcheck += frac -> pointbatch;
+        }
+        for (w = 0; w < numw; w++){
+            funcnums[w] = pickfunc(frac, rnguniform(rng));
+        }
+        walkerstep(numw, x, y, funcnums, frac -> maps, frac -> kernels);
+        for (w = 0; w < numw && i + w < frac -> numpoints; w++){
+            plotpoint(frac, x[w], y[w], funcnums[w]);
+            for (j = 0; j < frac -> numviews; j++) plotview(&(frac -> views[j]), x[w], y[w], funcnums[w]);
+            if (frac -> keeppoints){
+                frac -> xs[i + w] = x[w];
+                frac -> ys[i + w] = y[w];
+                frac -> colours[i + w] = funcnums[w];
+            }
+            if (fabs(x[w]) > max) max = fabs(x[w]);
+            if (fabs(y[w]) > max) max = fabs(y[w]);
+        }
+    }
+    frac -> pointsused = (i < frac -> numpoints) ? i : frac -> numpoints;
     return max;
 }
 
@@ -575,8 +1102,29 @@ int generatefrac(struct Fractal *frac){
      * fractals if they were too large to fit into the -1 to 1 
      * square, however, this is no longer used as non-affine
      * IFSs are not as simple to resize
+     *
+     * The genome is compiled into frac -> maps first, so the
+     * genome must not change while points are being generated.
+     * The points are drawn in the pixel map as they are generated,
+     * using the viewing window in frac -> window. If frac -> renderthreads
+     * is more than 1 and there are enough points, they are split between
+     * that many threads (see renderparallel), unless they are kept.
+     * With frac -> engine ENGINESET the image is drawn by generateset 
+     * instead, and no points are kept. With ENGINEFANOUT the points are
+     * generated by generatefanout, on one thread or in each chunk.
      */
-    double max = generatepoints(frac);
+    compilegenome(frac);
+    if (frac -> keeppoints) allocpoints(frac);
+    clearmatrix(frac);
+    double max;
+    if (frac -> engine == ENGINESET) max = generateset(frac);
+    else if (frac -> renderthreads > 1 && frac -> keeppoints == 0 && frac -> numpoints > RENDERCHUNK){
+        max = renderparallel(frac);
+    }
+    else if (frac -> engine == ENGINEFANOUT) max = generatefanout(frac);
+    else if (frac -> numwalkers > 1) max = generatewalkers(frac);
+    else max = generatepoints(frac);
+    finishmatrix(frac);
     int resized = 0;    
     /*
     int i = 0;
@@ -593,66 +1141,241 @@ int generatefrac(struct Fractal *frac){
     return resized;
 }
 
-int * pointtocoord(double x, double y, double minx, double maxx, double miny, double maxy){
+void pointtocoord(double x, double y, double *window, int width, int height, int *px, int *py){
     /* This function is used to convert a point (x,y) to pixel coordinates
-     * on a screen with viewing region [minx,maxx]x[miny,maxy]
+     * on a width x height screen with viewing region [minx,maxx]x[miny,maxy] 
+     * given by window. Points outside of the screen (or NaN) are clamped
+     * to it before being converted to integers
      */
-    int *coords = ivecmem(2);
-    coords[0] = (int)(WIDTH/2  + WIDTH/2  * ((x - minx)/(maxx - minx)*2 - 1));
-    coords[1] = (int)(HEIGHT/2 - HEIGHT/2 * ((y - miny)/(maxy - miny)*2 - 1));
-    return coords;
+    double cx = width/2  + width/2  * ((x - window[0])/(window[1] - window[0])*2 - 1);
+    double cy = height/2 - height/2 * ((y - window[2])/(window[3] - window[2])*2 - 1);
+    if (!(cx > 0)) cx = 0;
+    if (!(cy > 0)) cy = 0;
+    if (cx > width)  cx = width;
+    if (cy > height) cy = height;
+    *px = (int)cx;
+    *py = (int)cy;
+    return;
 }
 
-void generatematrix(struct Fractal *frac, double *window){
-    /* This function is used to transform the points of a fractal
-     * to a matrix of size HEIGHT x WIDTH which will be used to
-     * generate an image of the fractal.
-     */
-    int i,j,k,x,y;
-    int dotsize = DOTSIZE; //positive odd integer - defines the size of a point
-    int white = 255;
-    int **bm = frac -> bm;
-    
-    //start off with a fully white image
-    for (i = 0; i < HEIGHT; i++){
-        for (j = 0; j < WIDTH; j++){
-            bm[i][j] = white;
+void clearmatrix(struct Fractal *frac){
+    /* This function sets the matrix of a fractal to a fully
+     * white image, before any points are put into it
+     */
+    memset(frac -> bm, BLANKPIXEL, (size_t)frac -> height*frac -> width*sizeof(unsigned char));
+    if (frac -> density != NULL) cleardensity(frac -> density);
+    for (int v = 0; v < frac -> numviews; v++){
+        struct FracView *view = &(frac -> views[v]);
+        if (view -> samewindow){
+            for (int i = 0; i < 4; i++) view -> window[i] = frac -> window[i];
         }
+        memset(view -> bm, BLANKPIXEL, (size_t)view -> height*view -> width*sizeof(unsigned char));
     }
     //numb is the number of pixels corresponding to the attractor
-    //avgx and avgy are the pixel centroid coordinates
-    int numb = 0;
-    int avgx = 0;
-    int avgy = 0;
-    int *coords;
-    for (i = 0; i < frac -> numpoints; i++){
-	coords = pointtocoord(frac ->xs[i], frac->ys[i], window[0], 
-                              window[1], window[2], window[3]);
-        x = coords[0];
-        y = coords[1];
-        if (dotsize %2 != 0) {
-             for (j = -1 * (dotsize -1)/2; j <= (dotsize - 1)/2; j++){
-                 for (k = -1 * (dotsize -1)/2; k <= (dotsize -1)/2; k++){
-                     if (x >= WIDTH  - dotsize/2 - 1) x = WIDTH  - dotsize/2 - 1;
-                     if (y >= HEIGHT - dotsize/2 - 1) y = HEIGHT - dotsize/2 - 1;
-                     if (x <= dotsize/2) x = dotsize;
-                     if (y <= dotsize/2) y = dotsize;
-                     if (bm[y+j][x+k] == 255){
-                         avgx += x+k;
-                         avgy += y+j;
-                         numb += 1;
-                     }
-                     bm[y+j][x+k] = frac -> colours[i];
-                }
+    //the sums are used for the pixel centroid and standard deviations
+    struct FracStats *stats = &(frac -> stats);
+    frac -> numb = 0;
+    stats -> numb  = 0;
+    stats -> sumx  = 0;
+    stats -> sumy  = 0;
+    stats -> sumxx = 0;
+    stats -> sumyy = 0;
+    stats -> minx  = frac -> width;
+    stats -> maxx  = -1;
+    stats -> miny  = frac -> height;
+    stats -> maxy  = -1;
+    memset(stats -> funccounts, 0, frac -> numfuncs * sizeof(int));
+    return;
+}
+
+void plotpoint(struct Fractal *frac, double px, double py, int colour){
+    /* This function puts a single point (px, py) of a fractal
+     * into its height x width matrix, using the viewing window 
+     * frac -> window, and updates the pixel statistics in frac -> stats
+     * and the density histogram, if there is one. Points are drawn as DOTSIZE x DOTSIZE squares, and points 
+     * on or past the edge of the screen are moved onto its border.
+     * If frac -> lastchunk isn't NULL, the pixels drawn are marked with
+     * frac -> chunk (see mergeworkers).
+     */
+    int j,k,x,y;
+    long long dx, dy;
+    int r = (DOTSIZE - 1)/2;
+    int width = frac -> width, height = frac -> height;
+    unsigned char *pixel;
+    struct FracStats *stats = &(frac -> stats);
+    struct FracDensity *density = frac -> density;
+    pointtocoord(px, py, frac -> window, width, height, &x, &y);
+    if (x >= width  - DOTSIZE/2 - 1) x = width  - DOTSIZE/2 - 1;
+    if (y >= height - DOTSIZE/2 - 1) y = height - DOTSIZE/2 - 1;
+    if (x <= DOTSIZE/2) x = DOTSIZE;
+    if (y <= DOTSIZE/2) y = DOTSIZE;
+    for (j = -r; j <= r; j++){
+        pixel = &(frac -> bm[(y+j)*width + x]);
+        for (k = -r; k <= r; k++){
+            if (pixel[k] == BLANKPIXEL){
+                dx = x + k - width/2;
+                dy = y + j - height/2;
+                stats -> numb  += 1;
+                stats -> sumx  += dx;
+                stats -> sumy  += dy;
+                stats -> sumxx += dx*dx;
+                stats -> sumyy += dy*dy;
+                if (x + k < stats -> minx) stats -> minx = x + k;
+                if (x + k > stats -> maxx) stats -> maxx = x + k;
+                if (y + j < stats -> miny) stats -> miny = y + j;
+                if (y + j > stats -> maxy) stats -> maxy = y + j;
             }
+            else stats -> funccounts[pixel[k]]--;
+            stats -> funccounts[colour]++;
+            pixel[k] = colour;
+            if (frac -> lastchunk != NULL) frac -> lastchunk[(y+j)*width + x + k] = frac -> chunk;
+            if (density != NULL) densityhit(density, (y+j)*width + x + k);
+        }
+    }
+    return;
+}
+
+void plotview(struct FracView *view, double px, double py, int colour){
+    /* This function puts a single point into a view (see addview) 
+     * the same way plotpoint does, without keeping any stats
+     */
+    int j,k,x,y;
+    int r = (DOTSIZE - 1)/2;
+    pointtocoord(px, py, view -> window, view -> width, view -> height, &x, &y);
+    if (x >= view -> width  - DOTSIZE/2 - 1) x = view -> width  - DOTSIZE/2 - 1;
+    if (y >= view -> height - DOTSIZE/2 - 1) y = view -> height - DOTSIZE/2 - 1;
+    if (x <= DOTSIZE/2) x = DOTSIZE;
+    if (y <= DOTSIZE/2) y = DOTSIZE;
+    for (j = -r; j <= r; j++){
+        for (k = -r; k <= r; k++){
+            view -> bm[(y+j)*view -> width + x + k] = colour;
+            if (view -> lastchunk != NULL) view -> lastchunk[(y+j)*view -> width + x + k] = view -> chunk;
+        }
+    }
+    return;
+}
+
+void countmatrix(struct Fractal *frac){
+    /* This function works out the pixel statistics in frac -> stats 
+     * from the pixel map alone, giving the same stats plotpoint would
+     * have kept while drawing it. It is used when the pixel map is put
+     * together from several others (see mergeworkers).
+     */
+    int i, j;
+    long long dx, dy;
+    int width = frac -> width, height = frac -> height;
+    unsigned char *pixel;
+    struct FracStats *stats = &(frac -> stats);
+    stats -> numb  = 0;
+    stats -> sumx  = 0;
+    stats -> sumy  = 0;
+    stats -> sumxx = 0;
+    stats -> sumyy = 0;
+    stats -> minx  = width;
+    stats -> maxx  = -1;
+    stats -> miny  = height;
+    stats -> maxy  = -1;
+    memset(stats -> funccounts, 0, frac -> numfuncs * sizeof(int));
+    for (i = 0; i < height; i++){
+        pixel = &(frac -> bm[i*width]);
+        for (j = 0; j < width; j++){
+            if (pixel[j] == BLANKPIXEL) continue;
+            dx = j - width/2;
+            dy = i - height/2;
+            stats -> numb  += 1;
+            stats -> sumx  += dx;
+            stats -> sumy  += dy;
+            stats -> sumxx += dx*dx;
+            stats -> sumyy += dy*dy;
+            if (j < stats -> minx) stats -> minx = j;
+            if (j > stats -> maxx) stats -> maxx = j;
+            if (i < stats -> miny) stats -> miny = i;
+            if (i > stats -> maxy) stats -> maxy = i;
+            stats -> funccounts[pixel[j]]++;
+        }
+    }
+    return;
+}
+
+void finishmatrix(struct Fractal *frac){
+    /* This function calculates the number of pixels and the pixel
+     * centroid once all the points of a fractal are in its matrix
+     */
+    struct FracStats *stats = &(frac -> stats);
+    frac -> numb = stats -> numb;
+    if (stats -> numb > 0){
+        frac -> avgx = frac -> width/2  + (double)stats -> sumx/stats -> numb;
+        frac -> avgy = frac -> height/2 + (double)stats -> sumy/stats -> numb;
+    }
+    return;
+}
+
+void generatematrix(struct Fractal *frac, double *window){
+    /* This function is used to transform the kept points of a fractal
+     * (see allocpoints) to a matrix of size height x width which will
+     * be used to generate an image of the fractal. It is only needed
+     * to draw the points again, eg. with a different window, since
+     * generatefrac already draws the points as they are generated.
+     */
+    int i;
+    for (i = 0; i < 4; i++) frac -> window[i] = window[i];
+    clearmatrix(frac);
+    for (i = 0; i < frac -> pointsused; i++){
+        plotpoint(frac, frac -> xs[i], frac -> ys[i], frac -> colours[i]);
+        for (int v = 0; v < frac -> numviews; v++){
+            plotview(&(frac -> views[v]), frac -> xs[i], frac -> ys[i], frac -> colours[i]);
         }
     }
-    frac -> avgx = avgx/(int)numb;
-    frac -> avgy = avgy/(int)numb;
-    frac -> numb = numb;
+    finishmatrix(frac);
     return;
 }
 
+int packgenome(int numfuncs, double **genome, double *blob){
+    /* This function copies the parameters of a genome that are used
+     * into blob, in the same order as the genome columns of fracdata.dat:
+     * multiplicative parameters, additive parameters, probabilities and
+     * functypes. blob must have room for 14*numfuncs doubles. The number
+     * of doubles used is returned.
+     */
+    int i, j, len = 0, params = 0;
+    for (i = 0; i < numfuncs; i++){
+        for (j = 0; j < multindjump(genome[3][i]); j++) blob[len++] = genome[0][params + j];
+        params += multindjump(genome[3][i]);
+    }
+    params = 0;
+    for (i = 0; i < numfuncs; i++){
+        for (j = 0; j < addindjump(genome[3][i]); j++) blob[len++] = genome[1][params + j];
+        params += addindjump(genome[3][i]);
+    }
+    for (i = 0; i < numfuncs; i++) blob[len++] = genome[2][i];
+    for (i = 0; i < numfuncs; i++) blob[len++] = genome[3][i];
+    return len;
+}
+
+int unpackgenome(int numfuncs, double *blob, int len, double **genome){
+    /* This function is the inverse of packgenome. The functypes are 
+     * the last numfuncs doubles of blob, and they say how many of 
+     * the others belong to each function. It returns 1 if len doesn't
+     * match the functypes, and 0 otherwise.
+     */
+    int i, nummults = 0, numadds = 0;
+    double *types;
+    if (len < 2*numfuncs) return 1;
+    types = &(blob[len - numfuncs]);
+    for (i = 0; i < numfuncs; i++){
+        nummults += multindjump(types[i]);
+        numadds  += addindjump(types[i]);
+    }
+    if (nummults + numadds + 2*numfuncs != len) return 1;
+    for (i = 0; i < nummults; i++) genome[0][i] = blob[i];
+    for (i = 0; i < numadds; i++)  genome[1][i] = blob[nummults + i];
+    for (i = 0; i < numfuncs; i++){
+        genome[2][i] = blob[nummults + numadds + i];
+        genome[3][i] = types[i];
+    }
+    return 0;
+}
+
 void freegenome(struct Fractal *frac){
     /* This function frees the genome memory */
     free(frac -> genome[0]);
@@ -665,13 +1388,21 @@ void freegenome(struct Fractal *frac){
 
 void freefrac(struct Fractal *frac){
     /* This function frees the memory of a fractal structure */
-    for (int i = 0; i < HEIGHT; i++){
-        free(frac -> bm[i]);
-    }
     free(frac -> bm);
+    free(frac -> boxes);
+    for (int v = 0; v < frac -> numviews; v++) free(frac -> views[v].bm);
+    free(frac -> views);
+    freedensity(frac -> density);
+    freefracset(frac -> set);
+    freefanout(frac -> fan);
     freegenome(frac);
+    free(frac -> maps);
+    free(frac -> aliasprob);
+    free(frac -> alias);
+    free(frac -> stats.funccounts);
     free(frac -> xs);
     free(frac -> ys);
+    free(frac -> colours);
     return;
 }
 
@@ -3,12 +3,99 @@
  *
  * FILE NAME: Fractals.h
  */
-#define HEIGHT 640
+#include "rng.h"
+#define HEIGHT 640      //default resolution, see resizefrac
 #define WIDTH 640
+#define DOTSIZE 1       //must be an odd positive integer
+#define MINRES (2*DOTSIZE + 1)  //smallest width or height a dot fits in, see plotpoint
+#define BLANKPIXEL 255  //value of pixels with no points in the pixel map
+#define PACKEDROW(width) (((width)+7)/8) //bytes per row of a packed bitmap (see packbitmap)
+#define NUMWALKERS 8    //default number of orbits followed at once
+#define MAXWALKERS 16
+#define POINTBATCH 1000000  //default points between checks for new pixels when adaptive
+#define PILOTMAXRES 128     //largest resolution of pilot renders (see pilotfrac)
+#define BURNIN 100          //points thrown away at the start of every orbit, unless sized by checkorbit
+#define MINBURNIN 20        //range of the burn-ins sized by checkorbit
+#define MAXBURNIN 2000
+#define HEALTHSTEPS 256     //steps of the warm-up orbit followed by checkorbit
+#define HEALTHTRIES 20      //genomes tried by checkorbit, when there is no pilot render
+#define DIVERGEBOUND 1e10   //orbits further than this from the origin have diverged
+#define MINBOXES 8          //fewest boxes across a level used for box counting
+#define MINCOVERAGE 0.0    //default new pixels per point at or below which adaptive generation stops
+#define FILENAMELEN 124     //longest png filename, including the directory
+#define PNGQUEUESIZE 4      //default pngs waiting per encoder thread (see pngqueue.c)
+#define RESUMEWINDOW 1024   //fractals in a row with images that end the check of resumecount
+#define MAXRESTRICTIONS 20  //most function types that can be restricted in a run
+#define MAXVIEWS 8          //most extra images drawn from the same points (see addview)
+#define KERNELLIBM 0        //walkers use libm's cos, sin and tanh (see walkerstep)
+#define KERNELVEC 1         //walkers use the vectorized versions in vecmath.c
+#define KERNELFAST 2        //walkers use the faster approximations in vecmath.c
+#define PROBSEQUAL 0        //every function of an IFS is picked equally often
+#define PROBSCONTRACTION 1  //functions are picked in proportion to their area factor (see weightprobs)
+#define MINPROBWEIGHT 0.01  //smallest area factor used by weightprobs
+#define SAMPLERREJECT 0     //draw function parameters until they are contractive (see generatemults)
+#define SAMPLERDIRECT 1     //draw contractive functions directly (see generatemultsdirect)
+#define NUMFUNCTYPES 11
+#define ENGINECHAOS 0       //draw fractals with the chaos game (see generatepoints)
+#define ENGINESET 1         //draw fractals by iterating the Hutchinson operator on the pixels (see hutchinson.c)
+#define ENGINEFANOUT 2      //generate points by applying compositions of the functions to seeds (see fanout.c)
+#define FANOUTBATCH 16384   //points in each batch of the fan-out engine
+#define SETSEEDS 64         //chaos game points the set engine starts from
+#define SETBATCH 100000     //chaos game points the set engine plays between checks for new pixels
+#define MAXSUPERSAMPLE 4    //most cells across each pixel used by the set engine
+#define RENDERCHUNK 262144  //points in each chunk when plotting a fractal on several threads (see render.c)
+
+struct FracMap{
+        /* A single function of an IFS compiled out of the genome, see compilegenome() */
+        int type, kindx, kindy;
+        double m[8], a[4];
+};
+
+struct FracStats{
+        /* Statistics of the lit pixels of a fractal, updated as pixels are
+         * drawn (see plotpoint). Sums are of pixel coordinates relative to
+         * the centre of the image. funccounts[i] is the number of pixels 
+         * last drawn by function i.
+         */
+        long long numb, sumx, sumy, sumxx, sumyy;
+        int minx, maxx, miny, maxy, *funccounts;
+};
+
+struct FracView{
+        /* An extra image of a fractal, drawn from the same points as 
+         * its pixel map but at its own resolution and viewing window
+         */
+        int width, height, samewindow;  //samewindow is 1 to use the fractal's window
+        double window[4];
+        unsigned char *bm;
+        int chunk, *lastchunk;  //see the Fractal fields of the same names
+};
 
 struct Fractal{
-        double dimension, stddevx, stddevy, *xs, *ys, **genome;
-        int fracnum, numfuncs, numpoints, numb, dist, avgx, avgy, **bm, *colours, coloured;
+        double dimension, dimfit, stddevx, stddevy, avgx, avgy, *xs, *ys, **genome, window[4], mincoverage;
+        int fracnum, numfuncs, numpoints, numb, dist, *colours, coloured, numwalkers, keeppoints;
+        int adaptive, minpoints, pointbatch, pointsused, pilottries;
+        int width, height, numviews, renderthreads, kernels, probpolicy, sampler;
+        double minscale, maxscale;  //range of the singular values drawn by SAMPLERDIRECT
+        int health, burnin;         //burn-in of each orbit, sized by checkorbit if health is set
+        double contraction, lipschitz;  //estimated by checkorbit, or -1
+        int engine, supersample;    //see generatefrac, and setsupersample for supersample 0
+        int fandepth;               //depth of the compositions used by ENGINEFANOUT, 0 to fill a batch
+        struct FracSet *set;        //scratch space for ENGINESET, or NULL
+        struct FracFanout *fan;     //scratch space for ENGINEFANOUT, or NULL
+        double *aliasprob;      //alias table of the probabilities in genome[2], see buildalias
+        int *alias;
+        struct PilotOptions *pilot;
+        struct FracStats stats;
+        unsigned char *boxes;   //scratch space for box counting, see dimension()
+        unsigned char *bm;      //height x width pixel map, bm[row*width + col] is the function 
+                                //that last drew the pixel or BLANKPIXEL
+        int chunk, *lastchunk;  //when plotting on several threads, the chunk being plotted and
+                                //lastchunk[i] the chunk that last drew pixel i, or NULL (see render.c)
+        struct FracView *views; //numviews extra images, see addview
+        struct FracDensity *density;    //points per pixel of the pixel map, or NULL (see density.c)
+        struct FracMap *maps;
+        struct FracRNG rng;
 };
 
 double f(double *val, double point, double functype);
@@ -18,18 +105,45 @@ int multindjump(int functype);
 int addindjump(int functype);
 int piecewisecond(double x, double y);
 void func(double *x, double *y, double **genome, int funcnum, double functype);
-double validranddouble(double functype);
-void generatemults(double **genome, double functype, int *multparams);
-void generateadds(double **genome, double functype, int *addparams);
+double fkernel(double a, double b, double point, int kind);
+void compilemap(struct FracMap *map, double **genome, int funcnum);
+void compilegenome(struct Fractal *frac);
+void buildalias(int numfuncs, double *probs, double *aliasprob, int *alias);
+int pickfunc(struct Fractal *frac, double num);
+double areafactor(struct FracMap *map, double *window);
+void weightprobs(struct Fractal *frac);
+void mapfunc(double *x, double *y, struct FracMap *map);
+double validranddouble(struct FracRNG *rng, double functype);
+void generatemults(struct FracRNG *rng, double **genome, double functype, int *multparams);
+void drawcontraction(struct FracRNG *rng, double *m, int stride, double minscale, double maxscale);
+void generatemultsdirect(struct FracRNG *rng, double **genome, double functype, int *multparams, 
+                         double minscale, double maxscale);
+int allowedtypes(int *restrictions, int numrestrictions, int *allowed);
+void generatetypes(struct Fractal *frac, int *restrictions, int numrestrictions, int disperse);
+void generateadds(struct FracRNG *rng, double **genome, double functype, int *addparams);
 void generategenome(struct Fractal *frac, int *restrictions, int numrestrictions, int disperse);
 void ordergenome(int numfuncs, double **genome);
 double funcdeterminant(double a, double b, double c, double d);
 int validatefunc(double a, double b, double c, double d);
 double ** mallocgenome(int numfuncs);
+int packgenome(int numfuncs, double **genome, double *blob);
+int unpackgenome(int numfuncs, double *blob, int len, double **genome);
 void initializefrac(struct Fractal *frac, int numfuncs, int numpoints);
+void resizefrac(struct Fractal *frac, int width, int height);
+void addview(struct Fractal *frac, int width, int height, double *window);
+int stopearly(struct Fractal *frac, int numdone, int *lastnumb);
+void resetfrac(struct Fractal *frac);
+void allocpoints(struct Fractal *frac);
 double generatepoints(struct Fractal *frac);
+void walkerstep(int numw, double *x, double *y, int *funcnums, struct FracMap *maps, int kernels);
+double generatewalkers(struct Fractal *frac);
 int generatefrac(struct Fractal *frac);
-int * pointtocoord(double x, double y, double minx, double maxx, double miny, double maxy);
+void pointtocoord(double x, double y, double *window, int width, int height, int *px, int *py);
+void clearmatrix(struct Fractal *frac);
+void plotpoint(struct Fractal *frac, double px, double py, int colour);
+void plotview(struct FracView *view, double px, double py, int colour);
+void countmatrix(struct Fractal *frac);
+void finishmatrix(struct Fractal *frac);
 void generatematrix(struct Fractal *frac, double *window);
 void freegenome(struct Fractal *frac);
 void freefrac(struct Fractal *frac);
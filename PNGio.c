@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <png.h>
+#include <zlib.h>
 #include <math.h>
 #include "PNGio.h"
 #include "Fractals.h"
@@ -26,9 +27,12 @@ void funcnumtocolours(int colour, int *r, int *g, int *b){
      *           2:    yellow
      *           3:    green
      *           4:    blue
-     * add more colours if you want to colour an attractor
-     * that has more than 4 functions in its IFS
+     *          5+:    hues spaced by the golden angle, alternating
+     *                 between full and 3/4 brightness, so that 
+     *                 neighbouring function numbers never look alike
      */
+    double h, v, f;
+    int sector;
 
     if (colour == 0){
         *r = 255;
@@ -55,6 +59,100 @@ void funcnumtocolours(int colour, int *r, int *g, int *b){
         *g = 128;
         *b = 255;
     }
+    else {
+        h = 6.*fmod(0.6 + 0.618033988749895*(colour - 4), 1.);
+        v = (colour%2 == 0) ? 255. : 191.;
+        sector = (int)h;
+        f = h - sector;
+        switch (sector){
+            case 0:  *r = v; *g = v*f;      *b = 0;         break;
+            case 1:  *r = v*(1.-f); *g = v; *b = 0;         break;
+            case 2:  *r = 0; *g = v;        *b = v*f;       break;
+            case 3:  *r = 0; *g = v*(1.-f); *b = v;         break;
+            case 4:  *r = v*f; *g = 0;      *b = v;         break;
+            default: *r = v; *g = 0;        *b = v*(1.-f);  break;
+        }
+    }
+    return;
+}
+
+void defaultpngsettings(struct PNGSettings *settings){
+    /* This function sets the png settings to libpng's defaults */
+    settings -> level    = -1;   //zlib compression level 0-9, -1 for the default (6)
+    settings -> strategy = -1;   //zlib strategy (eg. Z_RLE = 3), -1 for the default
+    settings -> filters  = -1;   //PNG_FILTER_* flags OR'd together, -1 for the default
+    settings -> encoding = PNGCOMPACT; //change this to PNGRGB for 24 bit colour pngs
+    return;
+}
+
+int checkpngsettings(struct PNGSettings *settings){
+    /* This function returns 0 if the png settings can be given to 
+     * libpng and zlib, else 1
+     */
+    return (settings -> level < -1 || settings -> level > 9)||
+           (settings -> strategy < -1 || settings -> strategy > Z_FIXED)||
+           (settings -> filters != -1 && 
+            (settings -> filters <= 0 || (settings -> filters & ~PNG_ALL_FILTERS) != 0))||
+           (settings -> encoding != PNGRGB && settings -> encoding != PNGCOMPACT);
+}
+
+void packbitmap(unsigned char *bm, int width, int height, unsigned char *packed){
+    /* This function packs a width x height pixel map (see Fractals.h) 
+     * into a bitmap with one bit per pixel, set where there is a point. 
+     * Each row takes PACKEDROW(width) bytes and the leftmost pixel is 
+     * the most significant bit, as in a 1 bit png.
+     */
+    int i, j, k;
+    int rowbytes = PACKEDROW(width);
+    unsigned char byte, *pixel;
+    for (i = 0; i < height; i++){
+        pixel = &(bm[i*width]);
+        for (j = 0; j < rowbytes; j++){
+            byte = 0;
+            for (k = 0; k < 8 && 8*j + k < width; k++){
+                byte |= (pixel[8*j + k] != BLANKPIXEL) << (7 - k);
+            }
+            packed[i*rowbytes + j] = byte;
+        }
+    }
+    return;
+}
+
+png_structp openpng(char *filename, FILE **fp, png_infop *info, struct PNGSettings *settings){
+    /* This function opens filename and sets up libpng to write to 
+     * it with the compression settings given (if settings isn't NULL).
+     * The png is written to filename.tmp and only moved to filename by
+     * closepng once it is complete, so a png that exists is never cut 
+     * short by a run being killed (see resumecount).
+     */
+    char tmpname[FILENAMELEN + 8];
+    snprintf(tmpname, FILENAMELEN + 8, "%s.tmp", filename);
+    if ((*fp = fopen(tmpname, "wb")) == NULL) abort();
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (!png) abort();
+    *info = png_create_info_struct(png);
+    if (!*info) abort();
+    png_init_io(png, *fp);
+    if (settings != NULL){
+        if (settings -> level >= 0)    png_set_compression_level(png, settings -> level);
+        if (settings -> strategy >= 0) png_set_compression_strategy(png, settings -> strategy);
+        if (settings -> filters >= 0)  png_set_filter(png, PNG_FILTER_TYPE_BASE, settings -> filters);
+    }
+    return png;
+}
+
+void closepng(char *filename, FILE *fp, png_structp png, png_infop info){
+    /* This function finishes a png opened with openpng and moves it
+     * into place as filename
+     */
+    char tmpname[FILENAMELEN + 8];
+    png_write_end(png, NULL);
+    png_destroy_write_struct(&png, &info);
+    snprintf(tmpname, FILENAMELEN + 8, "%s.tmp", filename);
+    if (fclose(fp) != 0 || rename(tmpname, filename) != 0){
+        fprintf(stderr, "Failed to write png (closepng): %s\n", filename);
+        exit(1);
+    }
     return;
 }
 
@@ -69,54 +167,246 @@ void WritePNG(char *filename, struct Fractal *frac){
      * according to the colours assigned in funcnumtocolours.
      * If coloured is 1 then the fractal is black.
      */
-    FILE *fp = fopen(filename, "wb");
-    if (!fp) abort();
-    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-    if (!png) abort();
-    png_infop info = png_create_info_struct(png);
-    if (!info) abort();
+    WritePNGpixels(filename, frac -> bm, frac -> width, frac -> height, frac -> coloured, frac -> numfuncs, NULL);
+    return;
+}
+
+void WritePNGpixels(char *filename, unsigned char *bm, int width, int height, int coloured, int numfuncs, 
+                    struct PNGSettings *settings){
+    /* This function is the same as WritePNG, but takes the width x height
+     * pixel map (see Fractals.h), colouring and number of functions directly so 
+     * that it can be used on a copy of the pixel map once the fractal 
+     * itself is gone. If settings is NULL, defaultpngsettings is used.
+     *
+     * With the PNGCOMPACT encoding, black fractals are written as 1 bit
+     * greyscale pngs (see WritePNGbits) and coloured ones as 8 bit palette
+     * pngs, where pixel values are used as palette indices directly and 
+     * the background is index numfuncs. With PNGRGB they are written as
+     * 24 bit colour pngs.
+     */
+    struct PNGSettings defaults;
+    if (settings == NULL){
+        defaultpngsettings(&defaults);
+        settings = &defaults;
+    }
+    if (settings -> encoding == PNGCOMPACT && coloured == 1){
+        unsigned char *packed;
+        if ((packed = (unsigned char *)malloc(height * PACKEDROW(width) * sizeof(unsigned char))) == NULL){
+            fprintf(stderr, "Malloc failed (WritePNGpixels)\n");
+            exit(1);
+        }
+        packbitmap(bm, width, height, packed);
+        WritePNGbits(filename, packed, width, height, settings);
+        free(packed);
+        return;
+    }
+    FILE *fp;
+    png_infop info;
+    png_structp png = openpng(filename, &fp, &info, settings);
     if (setjmp(png_jmpbuf(png))) abort();
-    png_init_io(png, fp);
+    int compact = (settings -> encoding == PNGCOMPACT);
     png_set_IHDR(
         png, 
         info, 
-        WIDTH, 
-        HEIGHT, 
+        width, 
+        height, 
         8, 
-        PNG_COLOR_TYPE_RGB, 
+        compact ? PNG_COLOR_TYPE_PALETTE : PNG_COLOR_TYPE_RGB, 
         PNG_INTERLACE_NONE, 
         PNG_COMPRESSION_TYPE_DEFAULT, 
         PNG_FILTER_TYPE_DEFAULT
     );
+    int r,g,b;
+    if (compact){
+        png_color palette[PNG_MAX_PALETTE_LENGTH];
+        for (int k = 0; k < numfuncs; k++){
+            funcnumtocolours(k, &r, &g, &b);
+            palette[k].red   = (png_byte) r;
+            palette[k].green = (png_byte) g;
+            palette[k].blue  = (png_byte) b;
+        }
+        palette[numfuncs].red = palette[numfuncs].green = palette[numfuncs].blue = 255;
+        png_set_PLTE(png, info, palette, numfuncs + 1);
+    }
     png_write_info(png, info); 
-    png_bytep *row_pointers = (png_bytep *)malloc(HEIGHT * sizeof(png_bytep));
-    for (int i = 0; i < HEIGHT; i++){
-        row_pointers[i] = (png_bytep)malloc(3 * WIDTH * sizeof(unsigned char));
+    png_bytep row;
+    if ((row = (png_bytep)malloc(3 * width * sizeof(unsigned char))) == NULL){
+        fprintf(stderr, "Malloc failed (WritePNG)\n");
+        exit(1);
     }
-    int r,g,b;
-    for (int i = 0; i < HEIGHT; i++){
-        for (int j = 0; j < WIDTH; j++){
-            if (frac -> bm[i][j] != 255 && frac -> coloured == 0){
-                funcnumtocolours(frac -> bm[i][j], &r, &g, &b);
-                row_pointers[i][3*j+0] = (unsigned char) r;
-                row_pointers[i][3*j+1] = (unsigned char) g;
-                row_pointers[i][3*j+2] = (unsigned char) b;
+    unsigned char *pixel;
+    for (int i = 0; i < height; i++){
+        pixel = &(bm[i*width]);
+        if (compact){
+            for (int j = 0; j < width; j++){
+                row[j] = (pixel[j] == BLANKPIXEL) ? numfuncs : pixel[j];
+            }
+            png_write_row(png, row);
+            continue;
+        }
+        for (int j = 0; j < width; j++){
+            if (pixel[j] != BLANKPIXEL && coloured == 0){
+                funcnumtocolours(pixel[j], &r, &g, &b);
+                row[3*j+0] = (unsigned char) r;
+                row[3*j+1] = (unsigned char) g;
+                row[3*j+2] = (unsigned char) b;
             }
-            else if (frac -> bm[i][j] != 255 && frac -> coloured == 1){
-                row_pointers[i][3*j+0] = (unsigned char) 0;
-                                row_pointers[i][3*j+1] = (unsigned char) 0;
-                                row_pointers[i][3*j+2] = (unsigned char) 0;
+            else if (pixel[j] != BLANKPIXEL && coloured == 1){
+                row[3*j+0] = (unsigned char) 0;
+                row[3*j+1] = (unsigned char) 0;
+                row[3*j+2] = (unsigned char) 0;
             }
             else {
-                row_pointers[i][3*j+0] = (unsigned char) 255;
-                row_pointers[i][3*j+1] = (unsigned char) 255;
-                row_pointers[i][3*j+2] = (unsigned char) 255;
+                row[3*j+0] = (unsigned char) 255;
+                row[3*j+1] = (unsigned char) 255;
+                row[3*j+2] = (unsigned char) 255;
             }
         }
+        png_write_row(png, row);
     }
-    png_write_image(png, row_pointers);
-    png_write_end(png, NULL);
-    fclose(fp);
-    if (png && info) png_destroy_write_struct(&png, &info);
+    free(row);
+    closepng(filename, fp, png, info);
     return;
 }
+
+void WritePNGbits(char *filename, unsigned char *packed, int width, int height, struct PNGSettings *settings){
+    /* This function writes a width x height packed bitmap (see packbitmap) as a 1 bit
+     * greyscale png with black points on a white background. The rows
+     * of the bitmap are handed to libpng as they are, which inverts 
+     * them since a set bit is white in a greyscale png.
+     */
+    FILE *fp;
+    png_infop info;
+    png_structp png = openpng(filename, &fp, &info, settings);
+    if (setjmp(png_jmpbuf(png))) abort();
+    png_set_IHDR(
+        png, 
+        info, 
+        width, 
+        height, 
+        1, 
+        PNG_COLOR_TYPE_GRAY, 
+        PNG_INTERLACE_NONE, 
+        PNG_COMPRESSION_TYPE_DEFAULT, 
+        PNG_FILTER_TYPE_DEFAULT
+    );
+    png_write_info(png, info); 
+    png_set_invert_mono(png);
+    for (int i = 0; i < height; i++){
+        png_write_row(png, &(packed[i*PACKEDROW(width)]));
+    }
+    closepng(filename, fp, png, info);
+    return;
+}
+
+void WritePNGgray(char *filename, unsigned char *gray, int width, int height, int bits, 
+                  struct PNGSettings *settings){
+    /* This function writes a width x height greyscale image (see 
+     * tonemapdensity) as an 8 or 16 bit greyscale png. 16 bit pixels 
+     * are two bytes each, most significant first, as libpng expects.
+     */
+    FILE *fp;
+    png_infop info;
+    png_structp png = openpng(filename, &fp, &info, settings);
+    if (setjmp(png_jmpbuf(png))) abort();
+    png_set_IHDR(
+        png, 
+        info, 
+        width, 
+        height, 
+        bits, 
+        PNG_COLOR_TYPE_GRAY, 
+        PNG_INTERLACE_NONE, 
+        PNG_COMPRESSION_TYPE_DEFAULT, 
+        PNG_FILTER_TYPE_DEFAULT
+    );
+    png_write_info(png, info); 
+    for (int i = 0; i < height; i++){
+        png_write_row(png, &(gray[(size_t)i*width*(bits/8)]));
+    }
+    closepng(filename, fp, png, info);
+    return;
+}
+
+int ReadPNGsize(char *filename, int *width, int *height){
+    /* This function reads the width and height of a png. It returns 
+     * 1 if the file can't be read, and 0 otherwise.
+     */
+    unsigned char header[24];
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return 1;
+    if (fread(header, 1, 24, fp) != 24 || png_sig_cmp(header, 0, 8) != 0){
+        fclose(fp);
+        return 1;
+    }
+    fclose(fp);
+    *width  = (header[16] << 24) | (header[17] << 16) | (header[18] << 8) | header[19];
+    *height = (header[20] << 24) | (header[21] << 16) | (header[22] << 8) | header[23];
+    return 0;
+}
+
+int ReadPNGpixels(char *filename, unsigned char *bm, int width, int height, int numfuncs){
+    /* This function reads a png written by WritePNG in any encoding
+     * back into a pixel map. White pixels are blank, pixels with the
+     * colour of one of the numfuncs functions are set to that function
+     * and any other pixels (eg. black) are set to 0. It returns 1 if the
+     * file can't be read or isn't height x width, and 0 otherwise.
+     */
+    int i, j, k, r, g, b, colours[3*BLANKPIXEL];
+    unsigned char *pixel;
+    png_bytep row;
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) return 1;
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (!png) abort();
+    png_infop info = png_create_info_struct(png);
+    if (!info) abort();
+    if (setjmp(png_jmpbuf(png))){
+        png_destroy_read_struct(&png, &info, NULL);
+        fclose(fp);
+        return 1;
+    }
+    png_init_io(png, fp);
+    png_read_info(png, info);
+    if (png_get_image_width(png, info) != (png_uint_32)width || png_get_image_height(png, info) != (png_uint_32)height){
+        png_destroy_read_struct(&png, &info, NULL);
+        fclose(fp);
+        return 1;
+    }
+    png_set_palette_to_rgb(png);
+    png_set_expand_gray_1_2_4_to_8(png);
+    png_set_gray_to_rgb(png);
+    png_set_strip_16(png);
+    png_set_strip_alpha(png);
+    png_read_update_info(png, info);
+    for (k = 0; k < numfuncs && k < BLANKPIXEL; k++){
+        funcnumtocolours(k, &(colours[3*k]), &(colours[3*k+1]), &(colours[3*k+2]));
+    }
+    if ((row = (png_bytep)malloc(3 * width * sizeof(unsigned char))) == NULL){
+        fprintf(stderr, "Malloc failed (ReadPNGpixels)\n");
+        exit(1);
+    }
+    for (i = 0; i < height; i++){
+        png_read_row(png, row, NULL);
+        pixel = &(bm[i*width]);
+        for (j = 0; j < width; j++){
+            r = row[3*j]; g = row[3*j+1]; b = row[3*j+2];
+            if (r == 255 && g == 255 && b == 255){
+                pixel[j] = BLANKPIXEL;
+                continue;
+            }
+            pixel[j] = 0;
+            for (k = 0; k < numfuncs && k < BLANKPIXEL; k++){
+                if (colours[3*k] == r && colours[3*k+1] == g && colours[3*k+2] == b){
+                    pixel[j] = k;
+                    break;
+                }
+            }
+        }
+    }
+    png_read_end(png, NULL);
+    free(row);
+    png_destroy_read_struct(&png, &info, NULL);
+    fclose(fp);
+    return 0;
+}
@@ -5,6 +5,23 @@
  * FILE NAME: PNGio.h
  */
 
+#define PNGRGB 0        //24 bit colour
+#define PNGCOMPACT 1    //1 bit greyscale if black, 8 bit palette if coloured
+
 struct Fractal;
+struct PNGSettings{
+        int level, strategy, filters, encoding;
+};
+
 void funcnumtocolours(int colour, int *r, int *g, int *b);
+void defaultpngsettings(struct PNGSettings *settings);
+int checkpngsettings(struct PNGSettings *settings);
 void WritePNG(char *filename, struct Fractal *frac);
+void packbitmap(unsigned char *bm, int width, int height, unsigned char *packed);
+void WritePNGpixels(char *filename, unsigned char *bm, int width, int height, int coloured, int numfuncs, 
+                    struct PNGSettings *settings);
+void WritePNGbits(char *filename, unsigned char *packed, int width, int height, struct PNGSettings *settings);
+void WritePNGgray(char *filename, unsigned char *gray, int width, int height, int bits, 
+                  struct PNGSettings *settings);
+int ReadPNGsize(char *filename, int *width, int *height);
+int ReadPNGpixels(char *filename, unsigned char *bm, int width, int height, int numfuncs);
@@ -0,0 +1,192 @@
+/* FILE NAME: density.c
+ *
+ * This file contains density histograms of fractals. The pixel
+ * map of a fractal only keeps the function that last drew each
+ * pixel, whereas a density histogram counts every point that 
+ * lands on a pixel, as the points are plotted (see plotpoint), 
+ * so it costs no extra pass over the points.
+ *
+ * Histograms are meant to be filled in by one thread each and 
+ * then added together (see mergedensities), so no locking is 
+ * needed while points are plotted. A histogram is written out 
+ * as an 8 or 16 bit greyscale png after tone mapping its counts 
+ * (see tonemapdensity).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "density.h"
+
+struct FracDensity * newdensity(int width, int height, int bits){
+    /* This function allocates an empty width x height histogram with 
+     * bits (32 or 16) bit counts. 16 bit counts take half the memory
+     * but saturate after 65535 points on a pixel.
+     */
+    struct FracDensity *density;
+    if ((density = (struct FracDensity *)malloc(sizeof(struct FracDensity))) == NULL){
+        fprintf(stderr, "Malloc failed (newdensity)\n");
+        exit(1);
+    }
+    if (bits != 16 && bits != 32){
+        fprintf(stderr, "Error, density counts must be 16 or 32 bits (%d)\n", bits);
+        exit(1);
+    }
+    density -> bits = bits;
+    density -> counts32 = NULL;
+    density -> counts16 = NULL;
+    density -> gray = NULL;
+    density -> graybits = 0;
+    density -> width = density -> height = 0;
+    resizedensity(density, width, height);
+    return density;
+}
+
+void resizedensity(struct FracDensity *density, int width, int height){
+    /* This function (re)allocates a histogram for a width x height 
+     * image and clears it
+     */
+    size_t size = (size_t)width*height;
+    if (density -> width != width || density -> height != height){
+        free(density -> counts32);
+        free(density -> counts16);
+        free(density -> gray);
+        density -> counts32 = NULL;
+        density -> counts16 = NULL;
+        density -> gray = NULL;
+        density -> width  = width;
+        density -> height = height;
+        if ((density -> bits == 32 && (density -> counts32 = (uint32_t *)malloc(size*sizeof(uint32_t))) == NULL)||
+            (density -> bits == 16 && (density -> counts16 = (uint16_t *)malloc(size*sizeof(uint16_t))) == NULL)||
+            ((density -> gray = (unsigned char *)malloc(2*size*sizeof(unsigned char))) == NULL)){
+            fprintf(stderr, "Malloc failed (resizedensity)\n");
+            exit(1);
+        }
+    }
+    cleardensity(density);
+    return;
+}
+
+void cleardensity(struct FracDensity *density){
+    /* This function sets every count of a histogram to 0 */
+    size_t size = (size_t)density -> width*density -> height;
+    if (density -> bits == 32) memset(density -> counts32, 0, size*sizeof(uint32_t));
+    else memset(density -> counts16, 0, size*sizeof(uint16_t));
+    return;
+}
+
+void densityhit(struct FracDensity *density, int i){
+    /* This function counts one more point on pixel i, unless its 
+     * count is already as large as it can be
+     */
+    if (density -> bits == 32){
+        if (density -> counts32[i] != UINT32_MAX) density -> counts32[i]++;
+    }
+    else if (density -> counts16[i] != UINT16_MAX) density -> counts16[i]++;
+    return;
+}
+
+uint32_t densitycount(struct FracDensity *density, int i){
+    /* This function returns the count of pixel i */
+    if (density -> bits == 32) return density -> counts32[i];
+    return density -> counts16[i];
+}
+
+uint32_t densitymax(struct FracDensity *density){
+    /* This function returns the largest count in a histogram */
+    size_t i, size = (size_t)density -> width*density -> height;
+    uint32_t max = 0;
+    if (density -> bits == 32){
+        for (i = 0; i < size; i++) if (density -> counts32[i] > max) max = density -> counts32[i];
+    }
+    else {
+        for (i = 0; i < size; i++) if (density -> counts16[i] > max) max = density -> counts16[i];
+    }
+    return max;
+}
+
+void mergedensity(struct FracDensity *dest, struct FracDensity *src){
+    /* This function adds the counts of src to dest, saturating. Both 
+     * histograms must be the same size and have the same count bits.
+     */
+    size_t i, size = (size_t)dest -> width*dest -> height;
+    uint32_t sum;
+    if (src -> width != dest -> width || src -> height != dest -> height || src -> bits != dest -> bits){
+        fprintf(stderr, "Error, can't merge histograms of different sizes\n");
+        exit(1);
+    }
+    if (dest -> bits == 32){
+        for (i = 0; i < size; i++){
+            sum = dest -> counts32[i] + src -> counts32[i];
+            dest -> counts32[i] = (sum < dest -> counts32[i]) ? UINT32_MAX : sum;
+        }
+    }
+    else {
+        for (i = 0; i < size; i++){
+            sum = (uint32_t)dest -> counts16[i] + src -> counts16[i];
+            dest -> counts16[i] = (sum > UINT16_MAX) ? UINT16_MAX : sum;
+        }
+    }
+    return;
+}
+
+void mergedensities(struct FracDensity **densities, int num){
+    /* This function adds num histograms into densities[0] as a tree:
+     * each round adds every other histogram into its neighbour, so 
+     * there are about log2(num) rounds, and the merges within a round
+     * touch different histograms and could be done by separate threads.
+     */
+    int i, step;
+    for (step = 1; step < num; step *= 2){
+        for (i = 0; i + step < num; i += 2*step){
+            mergedensity(densities[i], densities[i + step]);
+        }
+    }
+    return;
+}
+
+void tonemapdensity(struct FracDensity *density, int graybits, int mode, double gamma){
+    /* This function turns the counts of a histogram into a greyscale 
+     * image density -> gray of graybits (8 or 16) bit pixels, 16 bit 
+     * pixels being stored most significant byte first as in a png. Pixels with no 
+     * points are white and the densest pixel is black, like the black 
+     * fractal pngs. Counts are scaled to [0,1] by log(1+count)/log(1+max)
+     * with DENSITYLOG, which shows the faint parts of a fractal, or by 
+     * count/max with DENSITYGAMMA, and then raised to the power 1/gamma.
+     */
+    size_t i, size = (size_t)density -> width*density -> height;
+    uint32_t count, max = densitymax(density);
+    unsigned char *gray = density -> gray;
+    double scale, v;
+    int top = (graybits == 16) ? 65535 : 255, val;
+    if (max == 0) max = 1;
+    density -> graybits = graybits;
+    scale = (mode == DENSITYLOG) ? 1/log1p((double)max) : 1/(double)max;
+    for (i = 0; i < size; i++){
+        count = densitycount(density, i);
+        val = top;
+        if (count > 0){
+            v = (mode == DENSITYLOG) ? log1p((double)count)*scale : count*scale;
+            if (gamma != 1) v = pow(v, 1/gamma);
+            val = top - (int)(v*top + 0.5);
+        }
+        if (graybits == 16){
+            gray[2*i]     = val >> 8;
+            gray[2*i + 1] = val & 255;
+        }
+        else gray[i] = val;
+    }
+    return;
+}
+
+void freedensity(struct FracDensity *density){
+    /* This function frees a histogram made by newdensity */
+    if (density == NULL) return;
+    free(density -> counts32);
+    free(density -> counts16);
+    free(density -> gray);
+    free(density);
+    return;
+}
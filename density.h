@@ -0,0 +1,30 @@
+/* FILE NAME: density.h */
+#include <stdint.h>
+
+#define DENSITYLOG 0    //tone map log(1+count), then apply the gamma
+#define DENSITYGAMMA 1  //tone map count/maxcount, then apply the gamma
+
+struct FracDensity{
+        /* A histogram of the number of points that landed on each pixel 
+         * of a width x height image, counts[row*width + col], kept in 
+         * counts32 or counts16 depending on bits (32 or 16). Counts stop 
+         * at the largest value they can hold instead of wrapping. gray 
+         * is the last image made by tonemapdensity, with graybits bits 
+         * per pixel.
+         */
+        int width, height, bits, graybits;
+        uint32_t *counts32;
+        uint16_t *counts16;
+        unsigned char *gray;
+};
+
+struct FracDensity * newdensity(int width, int height, int bits);
+void resizedensity(struct FracDensity *density, int width, int height);
+void cleardensity(struct FracDensity *density);
+void densityhit(struct FracDensity *density, int i);
+uint32_t densitycount(struct FracDensity *density, int i);
+uint32_t densitymax(struct FracDensity *density);
+void mergedensity(struct FracDensity *dest, struct FracDensity *src);
+void mergedensities(struct FracDensity **densities, int num);
+void tonemapdensity(struct FracDensity *density, int graybits, int mode, double gamma);
+void freedensity(struct FracDensity *density);
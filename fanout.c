@@ -0,0 +1,193 @@
+/* FILE NAME: fanout.c
+ *
+ * This file contains the fan-out engine, which generates the points
+ * of a fractal without picking a function at random for each point.
+ * Once a point is on the attractor, so are its images under every 
+ * function, and under every composition of depth functions, so a 
+ * single point gives numfuncs + numfuncs^2 + ... + numfuncs^depth new 
+ * points without any random numbers.
+ *
+ * A batch starts from numseeds points of a chaos game orbit (after its
+ * burn-in) as level 0. Level l+1 is made by applying each function in
+ * turn to every point of level l, so the same function is applied to 
+ * a whole array of points at once (see mapbatch), which the compiler
+ * can vectorize, instead of one point after another along an orbit. 
+ * Every point of every level is plotted, coloured by the function 
+ * that made it, as in the chaos game.
+ *
+ * Every composition is used once, so the points are spread as if every
+ * function had the same probability. The probabilities of the functions
+ * (genome[2]) only change which seeds are picked.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "Fractals.h"
+#include "vecmath.h"
+#include "fanout.h"
+
+struct FracFanout * newfanout(int size){
+    /* This function allocates scratch space for batches of size points */
+    struct FracFanout *fan;
+    if (((fan = (struct FracFanout *)malloc(sizeof(struct FracFanout))) == NULL)||
+        ((fan -> xs = (double *)malloc(size*sizeof(double))) == NULL)||
+        ((fan -> ys = (double *)malloc(size*sizeof(double))) == NULL)||
+        ((fan -> args = (double *)malloc(size*sizeof(double))) == NULL)||
+        ((fan -> vals = (double *)malloc(size*sizeof(double))) == NULL)||
+        ((fan -> colours = (int *)malloc(size*sizeof(int))) == NULL)){
+        fprintf(stderr, "Malloc failed (newfanout)\n");
+        exit(1);
+    }
+    fan -> size = size;
+    return fan;
+}
+
+void freefanout(struct FracFanout *fan){
+    /* This function frees scratch space made by newfanout */
+    if (fan == NULL) return;
+    free(fan -> xs);
+    free(fan -> ys);
+    free(fan -> args);
+    free(fan -> vals);
+    free(fan -> colours);
+    free(fan);
+    return;
+}
+
+void mapbatch(struct FracMap *map, int n, double *x, double *y, double *newx, double *newy, 
+              double *args, double *vals, int kernels){
+    /* This function transforms the n points (x[i], y[i]) by a compiled
+     * function into (newx[i], newy[i]), like mapfunc. For the trig
+     * functions (functypes 1 to 9), each of the 4 terms a*f(b*x) or 
+     * a*f(b*y) is evaluated for every point at once with vcos()/vsin()/
+     * vtanh() (or their fast versions, see walkerstep), using args and
+     * vals as scratch space for n values. With kernels KERNELLIBM every
+     * point is done with mapfunc() instead.
+     */
+    int i, j, kind;
+    double *m = map -> m, *a = map -> a, *out;
+    if (map -> type == 0){
+        for (i = 0; i < n; i++){
+            newx[i] = m[0]*x[i] + m[1]*y[i] + a[0];
+            newy[i] = m[2]*x[i] + m[3]*y[i] + a[1];
+        }
+        return;
+    }
+    if (map -> type == 10 || kernels == KERNELLIBM){
+        for (i = 0; i < n; i++){
+            newx[i] = x[i];
+            newy[i] = y[i];
+            mapfunc(&(newx[i]), &(newy[i]), map);
+        }
+        return;
+    }
+    for (i = 0; i < n; i++){
+        newx[i] = a[0];
+        newy[i] = a[1];
+    }
+    for (j = 0; j < 4; j++){
+        kind = (j%2 == 0) ? map -> kindx : map -> kindy;
+        for (i = 0; i < n; i++) args[i] = m[2*j+1] * ((j%2 == 0) ? x[i] : y[i]);
+        if (kernels == KERNELFAST){
+            if (kind == 1)      vcosfast(n, vals, args);
+            else if (kind == 2) vsinfast(n, vals, args);
+            else                vtanhfast(n, vals, args);
+        }
+        else {
+            if (kind == 1)      vcos(n, vals, args);
+            else if (kind == 2) vsin(n, vals, args);
+            else                vtanh(n, vals, args);
+        }
+        out = (j < 2) ? newx : newy;
+        for (i = 0; i < n; i++) out[i] += m[2*j] * vals[i];
+    }
+    return;
+}
+
+int fanoutdepth(int numfuncs, int depth, int *numseeds){
+    /* This function returns the depth to fan out to, depth or, if it 
+     * is 0 or too deep, the deepest that fits a batch of FANOUTBATCH
+     * points, and sets numseeds to the number of seeds that fill a
+     * batch as well as they can.
+     */
+    long long levels = 1, width = 1;
+    int d = 0;
+    while (d < depth || depth <= 0){
+        if (levels + width*numfuncs > FANOUTBATCH) break;
+        width *= numfuncs;
+        levels += width;
+        d++;
+    }
+    *numseeds = FANOUTBATCH/levels;
+    return d;
+}
+
+double generatefanout(struct Fractal *frac){
+    /* This function generates the points of a fractal by fanning out
+     * from seeds through its functions (see the top of this file) 
+     * instead of generatepoints, to a depth of frac -> fandepth (or
+     * as deep as fits a batch if it is 0). The points are plotted and
+     * kept as in generatepoints, up to numpoints of them, and adaptive
+     * generation stops at the same points (see stopearly).
+     */
+    int i, j, f, l, w, numseeds, width, start, next, numbatch, funcnum;
+    int numfuncs = frac -> numfuncs;
+    int lastnumb = 0;
+    int nextcheck = frac -> pointbatch;
+    int depth = fanoutdepth(numfuncs, frac -> fandepth, &numseeds);
+    double x, y, max = 0;
+    struct FracRNG *rng = &(frac -> rng);
+    struct FracFanout *fan;
+    if (frac -> fan == NULL) frac -> fan = newfanout(FANOUTBATCH);
+    fan = frac -> fan;
+    x = rnguniform(rng);
+    y = rnguniform(rng);
+    for (i = 0; i < frac -> burnin; i++){
+        mapfunc(&x, &y, &(frac -> maps[rngint(rng, numfuncs)]));
+    }
+    i = 0;
+    while (i < frac -> numpoints){
+        /* level 0, the seeds */
+        for (w = 0; w < numseeds; w++){
+            funcnum = pickfunc(frac, rnguniform(rng));
+            mapfunc(&x, &y, &(frac -> maps[funcnum]));
+            fan -> xs[w] = x;
+            fan -> ys[w] = y;
+            fan -> colours[w] = funcnum;
+        }
+        /* level l+1 is every function applied to level l */
+        start = 0;
+        width = numseeds;
+        for (l = 0; l < depth; l++){
+            next = start + width;
+            for (f = 0; f < numfuncs; f++){
+                mapbatch(&(frac -> maps[f]), width, &(fan -> xs[start]), &(fan -> ys[start]),
+                         &(fan -> xs[next + f*width]), &(fan -> ys[next + f*width]), 
+                         fan -> args, fan -> vals, frac -> kernels);
+                for (w = 0; w < width; w++) fan -> colours[next + f*width + w] = f;
+            }
+            start = next;
+            width *= numfuncs;
+        }
+        numbatch = start + width;
+        for (j = 0; j < numbatch && i < frac -> numpoints; j++, i++){
+            if (i >= nextcheck){
+                if (stopearly(frac, i, &lastnumb)) break;
+                nextcheck += frac -> pointbatch;
+            }
+            plotpoint(frac, fan -> xs[j], fan -> ys[j], fan -> colours[j]);
+            for (w = 0; w < frac -> numviews; w++) plotview(&(frac -> views[w]), fan -> xs[j], fan -> ys[j], fan -> colours[j]);
+            if (frac -> keeppoints){
+                frac -> xs[i] = fan -> xs[j];
+                frac -> ys[i] = fan -> ys[j];
+                frac -> colours[i] = fan -> colours[j];
+            }
+            if (fabs(fan -> xs[j]) > max) max = fabs(fan -> xs[j]);
+            if (fabs(fan -> ys[j]) > max) max = fabs(fan -> ys[j]);
+        }
+        if (j < numbatch && i < frac -> numpoints) break;
+    }
+    frac -> pointsused = i;
+    return max;
+}
@@ -0,0 +1,21 @@
+/* FILE NAME: fanout.h */
+
+struct Fractal;
+struct FracMap;
+struct FracFanout{
+        /* Scratch space for generating the points of a fractal by fanning
+         * out through its functions (see generatefanout). xs, ys and 
+         * colours hold a batch of up to size points, level by level, and 
+         * args and vals are used to evaluate the trig kernels on a level.
+         */
+        int size;
+        double *xs, *ys, *args, *vals;
+        int *colours;
+};
+
+struct FracFanout * newfanout(int size);
+void freefanout(struct FracFanout *fan);
+void mapbatch(struct FracMap *map, int n, double *x, double *y, double *newx, double *newy, 
+              double *args, double *vals, int kernels);
+int fanoutdepth(int numfuncs, int depth, int *numseeds);
+double generatefanout(struct Fractal *frac);
@@ -0,0 +1,431 @@
+/* FILE NAME: fracdb.c
+ *
+ * This file contains the binary database of fractal metadata,
+ * which holds the same information as fracdata.dat but can be
+ * counted and searched without reading it as text. Each column
+ * is its own file in the run's directory (eg. fracdb_dimension),
+ * holding one fixed width value per fractal, so a query only 
+ * reads the columns it uses. Genomes are kept in a blob with a
+ * column giving where each one ends.
+ *
+ * Every column is only ever appended to. A fractal is written
+ * to the genome blob first and its id last, each column flushed 
+ * before the next is written, and the number of records is the 
+ * length of the shortest column, cut back further while the last 
+ * record's genome runs past the end of the genome blob. So a run 
+ * that is killed part way through a record leaves the records before
+ * it whole, and the partly written one is cut off (see newdbwriter).
+ * Nothing is synced to disk, so this doesn't hold if the machine 
+ * itself goes down.
+ *
+ * Columns added to the format later (DBFIRSTADDED up to DBFUNCTYPES)
+ * may be missing or short in a database made before them. They 
+ * aren't counted, read as -1 past their end, and are padded with
+ * -1 when the database is next appended to.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Fractals.h"
+#include "fracdb.h"
+
+char *dbcolnames[DBNUMCOLS] = {"id", "numfuncs", "numpoints", "numb", "avgx", "avgy", "stddevx", 
+                               "stddevy", "dimension", "dimfit", "contraction", "lipschitz", 
+                               "functypes", "genomeend", "genome"};
+
+size_t dbcolsize(int col){
+    /* This function returns the size of one value of a column */
+    if (col < DBNUMINTS || col == DBFUNCTYPES) return sizeof(int32_t);
+    if (col == DBGENOMEEND) return sizeof(uint64_t);
+    return sizeof(double);
+}
+
+void dbfilename(char *filename, char *dirname, int col){
+    /* This function makes the name of the file of a column */
+    snprintf(filename, FILENAMELEN, "%sfracdb_%s", dirname, dbcolnames[col]);
+    return;
+}
+
+long long dbcount(char *dirname){
+    /* This function returns the number of fractals in the database 
+     * in dirname from the sizes of its column files, or -1 if there 
+     * is no database there. Records whose genome isn't all in the 
+     * genome blob aren't counted.
+     */
+    char filename[FILENAMELEN];
+    struct stat st;
+    long long count = -1, n;
+    uint64_t end;
+    FILE *fp;
+    for (int col = 0; col < DBGENOME; col++){
+        if (col >= DBFIRSTADDED && col < DBFUNCTYPES) continue;
+        dbfilename(filename, dirname, col);
+        if (stat(filename, &st) != 0) return -1;
+        n = st.st_size/dbcolsize(col);
+        if (count < 0 || n < count) count = n;
+    }
+    dbfilename(filename, dirname, DBGENOME);
+    if (stat(filename, &st) != 0) return -1;
+    dbfilename(filename, dirname, DBGENOMEEND);
+    if (count > 0 && (fp = fopen(filename, "rb")) != NULL){
+        while (count > 0){
+            if (fseek(fp, (count - 1)*sizeof(uint64_t), SEEK_SET) != 0 || 
+                fread(&end, sizeof(uint64_t), 1, fp) != 1 || end > st.st_size/sizeof(double)){
+                count--;
+            }
+            else break;
+        }
+        fclose(fp);
+    }
+    return count;
+}
+
+uint64_t dbtruncate(char *dirname, long long count){
+    /* This function cuts the database in dirname back to its first 
+     * count records, which it must have, and returns the length of 
+     * their genomes in the genome blob. Columns added to the format 
+     * later are cut back too, but not padded (see newdbwriter).
+     */
+    char filename[FILENAMELEN];
+    long long n;
+    uint64_t genomelen = 0;
+    struct stat st;
+    FILE *fp;
+    for (int col = 0; col < DBGENOME; col++){
+        dbfilename(filename, dirname, col);
+        n = count;
+        if (col >= DBFIRSTADDED && col < DBFUNCTYPES){
+            if (stat(filename, &st) != 0) continue;
+            if (st.st_size/(long long)dbcolsize(col) < count) n = st.st_size/dbcolsize(col);
+        }
+        if (truncate(filename, n*dbcolsize(col)) != 0){
+            fprintf(stderr, "Failed to truncate file (dbtruncate): %s\n", filename);
+            exit(1);
+        }
+    }
+    dbfilename(filename, dirname, DBGENOMEEND);
+    if (count > 0){
+        if ((fp = fopen(filename, "rb")) == NULL || 
+            fseek(fp, (count - 1)*sizeof(uint64_t), SEEK_SET) != 0 ||
+            fread(&genomelen, sizeof(uint64_t), 1, fp) != 1){
+            fprintf(stderr, "Failed to read file (dbtruncate): %s\n", filename);
+            exit(1);
+        }
+        fclose(fp);
+    }
+    dbfilename(filename, dirname, DBGENOME);
+    if (truncate(filename, genomelen*sizeof(double)) != 0){
+        fprintf(stderr, "Failed to truncate file (dbtruncate): %s\n", filename);
+        exit(1);
+    }
+    return genomelen;
+}
+
+struct FracDBWriter * newdbwriter(char *dirname){
+    /* This function opens the database in dirname for appending, 
+     * making it if it doesn't exist. Records left over from a run 
+     * that was interrupted part way through writing them are cut off,
+     * and columns added to the format since the database was made
+     * are padded with -1 up to the number of records.
+     */
+    char filename[FILENAMELEN];
+    long long n, count = dbcount(dirname);
+    double pad = -1;
+    struct stat st;
+    struct FracDBWriter *writer;
+    if (((writer = (struct FracDBWriter *)malloc(sizeof(struct FracDBWriter))) == NULL)||
+        ((writer -> blob = (double *)malloc(14*BLANKPIXEL*sizeof(double))) == NULL)){
+        fprintf(stderr, "Malloc failed (newdbwriter)\n");
+        exit(1);
+    }
+    if (count < 0) count = 0;
+    for (int col = 0; col < DBNUMCOLS; col++){
+        dbfilename(filename, dirname, col);
+        if ((writer -> files[col] = fopen(filename, "ab")) == NULL){
+            fprintf(stderr, "Failed to open file (newdbwriter): %s\n", filename);
+            exit(1);
+        }
+    }
+    writer -> genomelen = dbtruncate(dirname, count);
+    for (int col = DBFIRSTADDED; col < DBFUNCTYPES; col++){
+        dbfilename(filename, dirname, col);
+        if (stat(filename, &st) != 0){
+            fprintf(stderr, "Failed to open file (newdbwriter): %s\n", filename);
+            exit(1);
+        }
+        for (n = st.st_size/dbcolsize(col); n < count; n++) dbwrite(writer, col, &pad, 1);
+    }
+    return writer;
+}
+
+void dbwrite(struct FracDBWriter *writer, int col, void *vals, size_t num){
+    /* This function appends num values to a column and flushes it, so
+     * the columns of a record reach the files in the order they are 
+     * written (see the top of this file)
+     */
+    if (fwrite(vals, dbcolsize(col), num, writer -> files[col]) != num || fflush(writer -> files[col]) != 0){
+        fprintf(stderr, "Failed to write database (dbwrite): column %s\n", dbcolnames[col]);
+        exit(1);
+    }
+    return;
+}
+
+void dbappend(struct FracDBWriter *writer, struct Fractal *frac){
+    /* This function appends the record of a finished fractal */
+    int32_t ints[DBNUMINTS] = {frac -> fracnum, frac -> numfuncs, frac -> pointsused, frac -> numb};
+    double doubles[DBFUNCTYPES - DBNUMINTS] = {frac -> avgx, frac -> avgy, frac -> stddevx, 
+                                               frac -> stddevy, frac -> dimension, frac -> dimfit,
+                                               frac -> contraction, frac -> lipschitz};
+    int32_t functypes = 0;
+    int len = packgenome(frac -> numfuncs, frac -> genome, writer -> blob);
+    for (int i = 0; i < frac -> numfuncs; i++){
+        functypes |= 1 << (int)frac -> genome[3][i];
+    }
+    writer -> genomelen += len;
+    dbwrite(writer, DBGENOME, writer -> blob, len);
+    dbwrite(writer, DBGENOMEEND, &(writer -> genomelen), 1);
+    dbwrite(writer, DBFUNCTYPES, &functypes, 1);
+    for (int col = DBFUNCTYPES - 1; col >= DBNUMINTS; col--){
+        dbwrite(writer, col, &(doubles[col - DBNUMINTS]), 1);
+    }
+    for (int col = DBNUMINTS - 1; col >= 0; col--){
+        dbwrite(writer, col, &(ints[col]), 1);
+    }
+    return;
+}
+
+void dbcopyrecord(struct FracDBWriter *writer, struct FracDB *db, long long i){
+    /* This function appends record i of another database, in the 
+     * same order as dbappend
+     */
+    int len;
+    double *genome = dbgenome(db, i, &len);
+    writer -> genomelen += len;
+    dbwrite(writer, DBGENOME, genome, len);
+    dbwrite(writer, DBGENOMEEND, &(writer -> genomelen), 1);
+    for (int col = DBFUNCTYPES; col >= 0; col--){
+        dbwrite(writer, col, (char *)db -> cols[col] + i*dbcolsize(col), 1);
+    }
+    return;
+}
+
+void closedbwriter(struct FracDBWriter *writer){
+    /* This function closes a database opened with newdbwriter. The
+     * genome blob is closed first and the ids last, as in dbappend.
+     */
+    for (int col = DBNUMCOLS - 1; col >= 0; col--){
+        fclose(writer -> files[col]);
+    }
+    free(writer -> blob);
+    free(writer);
+    return;
+}
+
+void dbreadadded(struct FracDB *db, int col, char *filename){
+    /* This function reads a column added to the format later (see the 
+     * top of this file) into memory instead of mapping it, with -1 for
+     * the records past its end, or for every record if it is missing
+     */
+    double *vals;
+    FILE *fp;
+    if ((vals = (double *)malloc((db -> count + 1)*sizeof(double))) == NULL){
+        fprintf(stderr, "Malloc failed (dbreadadded)\n");
+        exit(1);
+    }
+    for (long long i = 0; i < db -> count; i++) vals[i] = -1;
+    if ((fp = fopen(filename, "rb")) != NULL){
+        if (fread(vals, sizeof(double), db -> count, fp) == 0 && ferror(fp)){
+            fprintf(stderr, "Failed to read file (dbreadadded): %s\n", filename);
+            exit(1);
+        }
+        fclose(fp);
+    }
+    db -> cols[col] = vals;
+    db -> sizes[col] = 0;
+    return;
+}
+
+struct FracDB * opendb(char *dirname){
+    /* This function maps the columns of the database in dirname into
+     * memory, read only. NULL is returned if there is no database.
+     */
+    char filename[FILENAMELEN];
+    int fd;
+    struct stat st;
+    struct FracDB *db;
+    long long count = dbcount(dirname);
+    if (count < 0) return NULL;
+    if ((db = (struct FracDB *)malloc(sizeof(struct FracDB))) == NULL){
+        fprintf(stderr, "Malloc failed (opendb)\n");
+        exit(1);
+    }
+    db -> count = count;
+    for (int col = 0; col < DBNUMCOLS; col++){
+        dbfilename(filename, dirname, col);
+        db -> cols[col] = NULL;
+        db -> sizes[col] = 0;
+        if (col >= DBFIRSTADDED && col < DBFUNCTYPES){
+            dbreadadded(db, col, filename);
+            continue;
+        }
+        if ((fd = open(filename, O_RDONLY)) < 0 || fstat(fd, &st) != 0){
+            fprintf(stderr, "Failed to open file (opendb): %s\n", filename);
+            exit(1);
+        }
+        if (st.st_size > 0){
+            db -> sizes[col] = st.st_size;
+            db -> cols[col] = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (db -> cols[col] == MAP_FAILED){
+                fprintf(stderr, "Failed to map file (opendb): %s\n", filename);
+                exit(1);
+            }
+        }
+        close(fd);
+    }
+    return db;
+}
+
+void closedb(struct FracDB *db){
+    /* This function unmaps a database opened with opendb */
+    for (int col = 0; col < DBNUMCOLS; col++){
+        if (db -> sizes[col] == 0) free(db -> cols[col]);
+        else munmap(db -> cols[col], db -> sizes[col]);
+    }
+    free(db);
+    return;
+}
+
+double * dbgenome(struct FracDB *db, long long i, int *len){
+    /* This function returns the genome of record i and sets len to its
+     * length. It can be turned back into a genome with unpackgenome.
+     */
+    uint64_t *ends = (uint64_t *)db -> cols[DBGENOMEEND];
+    uint64_t start = (i == 0) ? 0 : ends[i-1];
+    *len = ends[i] - start;
+    return &(((double *)db -> cols[DBGENOME])[start]);
+}
+
+void dbwriterow(FILE *fp, struct FracDB *db, long long i){
+    /* This function writes record i as a row of fracdata.dat 
+     * (see writefracrow), so the text can be made from the database.
+     * The columns added later aren't in fracdata.dat.
+     */
+    int len, col;
+    double *genome = dbgenome(db, i, &len);
+    for (col = 0; col < DBNUMINTS; col++){
+        fprintf(fp, "%d\t", ((int32_t *)db -> cols[col])[i]);
+    }
+    for (col = DBNUMINTS; col < DBFIRSTADDED; col++){
+        fprintf(fp, "%.15lf\t", ((double *)db -> cols[col])[i]);
+    }
+    for (int j = 0; j < len-1; j++){
+        fprintf(fp, "%.15lf\t", genome[j]);
+    }
+    fprintf(fp, "%.15lf\n", genome[len-1]);
+    return;
+}
+
+int dbcolumn(char *name){
+    /* This function returns the column with the given name that can 
+     * be compared in a query, or -1 if there isn't one
+     */
+    for (int col = 0; col < DBFUNCTYPES; col++){
+        if (strcasecmp(name, dbcolnames[col]) == 0) return col;
+    }
+    return -1;
+}
+
+int dbop(char *op){
+    /* This function returns the number of a comparison operator
+     * used by dbcompare, or -1 if it isn't one
+     */
+    char *ops[7] = {"<", "<=", ">", ">=", "=", "==", "!="};
+    for (int i = 0; i < 7; i++){
+        if (strcmp(op, ops[i]) == 0) return i;
+    }
+    return -1;
+}
+
+int dbcompare(double val, int op, double x){
+    /* This function compares val to x with the operator op (see dbop) */
+    switch (op){
+        case 0:  return val < x;
+        case 1:  return val <= x;
+        case 2:  return val > x;
+        case 3:  return val >= x;
+        case 6:  return val != x;
+        default: return val == x;
+    }
+}
+
+int dbfilter(struct FracDB *db, char **words, int numwords, unsigned char *selected){
+    /* This function clears selected[i] for the records that don't
+     * satisfy one condition of a query, which is either
+     *      column op value     (eg. dimension > 1.4)
+     *      contains functype t
+     * It returns 1 if the condition can't be understood.
+     */
+    long long i;
+    int col, op;
+    double x;
+    char *end;
+    if (numwords == 3 && strcasecmp(words[0], "contains") == 0 && strcasecmp(words[1], "functype") == 0){
+        int32_t *functypes = (int32_t *)db -> cols[DBFUNCTYPES];
+        int t = strtol(words[2], &end, 10);
+        if (*end != '\0' || t < 0 || t > 30) return 1;
+        for (i = 0; i < db -> count; i++){
+            selected[i] &= (functypes[i] >> t) & 1;
+        }
+        return 0;
+    }
+    if (numwords != 3 || (col = dbcolumn(words[0])) < 0 || (op = dbop(words[1])) < 0) return 1;
+    x = strtod(words[2], &end);
+    if (*end != '\0') return 1;
+    if (col < DBNUMINTS){
+        int32_t *vals = (int32_t *)db -> cols[col];
+        for (i = 0; i < db -> count; i++){
+            if (selected[i]) selected[i] = dbcompare(vals[i], op, x);
+        }
+    }
+    else {
+        double *vals = (double *)db -> cols[col];
+        for (i = 0; i < db -> count; i++){
+            if (selected[i]) selected[i] = dbcompare(vals[i], op, x);
+        }
+    }
+    return 0;
+}
+
+int dbquery(struct FracDB *db, char *query, unsigned char *selected){
+    /* This function sets selected[i] to 1 for the records matching a
+     * query and 0 for the rest. A query is a list of conditions (see 
+     * dbfilter) joined by AND, eg.
+     *      dimension > 1.4 AND contains functype 10
+     * Words have to be separated by spaces. An empty query matches 
+     * everything. It returns 1 if the query can't be understood.
+     */
+    char *copy, *words[64], *word, *save;
+    int numwords = 0, start = 0, ret = 0;
+    memset(selected, 1, db -> count);
+    if ((copy = strdup(query)) == NULL){
+        fprintf(stderr, "Malloc failed (dbquery)\n");
+        exit(1);
+    }
+    for (word = strtok_r(copy, " \t\n", &save); word != NULL && numwords < 64; word = strtok_r(NULL, " \t\n", &save)){
+        words[numwords++] = word;
+    }
+    for (int i = 0; i <= numwords && ret == 0; i++){
+        if (i == numwords || strcasecmp(words[i], "AND") == 0){
+            if (numwords > 0) ret = dbfilter(db, &(words[start]), i - start, selected);
+            start = i + 1;
+        }
+    }
+    free(copy);
+    return ret;
+}
@@ -0,0 +1,53 @@
+/* FILE NAME: fracdb.h */
+#include <stdint.h>
+
+#define DBID 0
+#define DBNUMFUNCS 1
+#define DBNUMPOINTS 2
+#define DBNUMB 3
+#define DBAVGX 4
+#define DBAVGY 5
+#define DBSTDDEVX 6
+#define DBSTDDEVY 7
+#define DBDIMENSION 8
+#define DBDIMFIT 9
+#define DBCONTRACTION 10    //see checkorbit, -1 if it wasn't run
+#define DBLIPSCHITZ 11
+#define DBFUNCTYPES 12  //bit t is set if the IFS has a function of type t
+#define DBGENOMEEND 13  //end of each genome in the genome blob, in doubles
+#define DBGENOME 14     //genomes as made by packgenome, one after another
+#define DBNUMCOLS 15
+#define DBNUMINTS 4     //columns before this are int32, the rest up to DBFUNCTYPES are doubles
+#define DBFIRSTADDED 10 //columns from here to DBFUNCTYPES were added to the format later, 
+                        //and read as -1 from databases without them (see opendb)
+
+struct Fractal;
+struct FracDBWriter{
+        /* The columns of a database open for appending, see newdbwriter */
+        FILE *files[DBNUMCOLS];
+        uint64_t genomelen;
+        double *blob;
+};
+
+struct FracDB{
+        /* The columns of a database mapped into memory, see opendb. 
+         * cols[c][i] is record i of column c, except for the genome blob
+         */
+        void *cols[DBNUMCOLS];
+        size_t sizes[DBNUMCOLS];    //size of each mapped column, 0 if cols[c] was filled in instead
+        long long count;
+};
+
+long long dbcount(char *dirname);
+uint64_t dbtruncate(char *dirname, long long count);
+struct FracDBWriter * newdbwriter(char *dirname);
+void dbwrite(struct FracDBWriter *writer, int col, void *vals, size_t num);
+void dbappend(struct FracDBWriter *writer, struct Fractal *frac);
+void dbcopyrecord(struct FracDBWriter *writer, struct FracDB *db, long long i);
+void closedbwriter(struct FracDBWriter *writer);
+struct FracDB * opendb(char *dirname);
+void closedb(struct FracDB *db);
+double * dbgenome(struct FracDB *db, long long i, int *len);
+void dbwriterow(FILE *fp, struct FracDB *db, long long i);
+int dbcolumn(char *name);
+int dbquery(struct FracDB *db, char *query, unsigned char *selected);
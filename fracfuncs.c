@@ -11,13 +11,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
-#include <time.h>
+#include <string.h>
 #include "Fractals.h"
 #include "fracfuncs.h"
 
-struct Fractal * makerandfrac(int numpoints, int numfuncs, int *restrictions, int numrestrictions, int disperse, double *window){
+struct Fractal * makerandfrac(int numpoints, int numfuncs, int *restrictions, int numrestrictions, int disperse, double *window, uint64_t seed, int fracnum){
     /* This function generates a random fractal. See Fractals.c -> generategenome() for an 
-     * explanation of the input parameters
+     * explanation of the input parameters. The fractal's random numbers all come from
+     * a generator seeded with seed and fracnum, so the same seed and fracnum always
+     * give the same fractal.
      */
     struct Fractal *frac;
     if ((frac = (struct Fractal *)malloc(sizeof(struct Fractal))) == NULL){
@@ -26,19 +28,295 @@ struct Fractal * makerandfrac(int numpoints, int numfuncs, int *restrictions, in
         }
     initializefrac(frac, numfuncs, numpoints);
     //frac -> coloured = 0;
+    fillrandfrac(frac, restrictions, numrestrictions, disperse, window, seed, fracnum);
+    return frac;
+}
+
+void fillrandfrac(struct Fractal *frac, int *restrictions, int numrestrictions, int disperse, double *window, uint64_t seed, int fracnum){
+    /* This function is the same as makerandfrac except that the random fractal
+     * is generated in a fractal structure that has already been initialized 
+     * (see initializefrac), replacing whatever fractal was in it before. 
+     * No memory is allocated, so workers can generate any number of fractals
+     * in the same structure.
+     *
+     * If frac -> pilot is set, each genome is first tried out with pilotfrac,
+     * and genomes that fail it are thrown away and generated again, up to
+     * pilot -> maxtries times. The number of genomes tried is stored in 
+     * frac -> pilottries.
+     *
+     * If frac -> health is set, each genome is checked with checkorbit 
+     * before its pilot render, which throws away genomes whose orbits
+     * diverge or don't contract after a few hundred points, and sizes
+     * the burn-in of the ones kept. Without a pilot render, up to 
+     * HEALTHTRIES genomes are tried.
+     *
+     * If the last genome tried still fails, it isn't drawn: its pixel
+     * map is left blank and frac -> pointsused is set to 0, which flags
+     * it in fracdata.dat and the database.
+     */
+    int maxtries = (frac -> pilot != NULL) ? frac -> pilot -> maxtries : HEALTHTRIES;
+    int failed = 0;
+    resetfrac(frac);
+    frac -> fracnum = fracnum;
+    rngseed(&(frac -> rng), seed, fracnum);
+    for (int i = 0; i < 4; i++) frac -> window[i] = window[i];
     generategenome(frac, restrictions, numrestrictions, disperse);
+    frac -> pilottries = 1;
+    if (frac -> pilot != NULL || frac -> health){
+        while ((failed = ((frac -> health && checkorbit(frac) != 0) || 
+                          (frac -> pilot != NULL && pilotfrac(frac, frac -> pilot) != 0))) && 
+               frac -> pilottries < maxtries){
+            generategenome(frac, restrictions, numrestrictions, disperse);
+            frac -> pilottries++;
+        }
+    }
+    if (failed){
+        clearmatrix(frac);
+        finishmatrix(frac);
+        frac -> pointsused = 0;
+        return;
+    }
     generatefrac(frac);
-    generatematrix(frac, window);
-    return frac;
+    return;
+}
+
+int checkorbit(struct Fractal *frac){
+    /* This function follows an orbit of a fractal for HEALTHSTEPS 
+     * points, along with a second orbit that starts a tiny distance
+     * away and is moved by the same functions. How much the distance
+     * between them shrinks each step estimates how fast the fractal's
+     * orbits contract. The distance is put back to its starting size 
+     * after every step so that it never underflows.
+     *
+     * frac -> contraction is set to the geometric mean of the shrink 
+     * factors and frac -> lipschitz to the largest one, which is how 
+     * much the functions stretch distances near the attractor at most.
+     * frac -> burnin is set to the number of points it takes orbits to
+     * shrink the bounding box of the warm-up orbit down to a pixel,
+     * twice over, between MINBURNIN and MAXBURNIN.
+     *
+     * It returns 0 if the orbit is healthy, and otherwise:
+     *      1: the orbit diverged, or became NaN or infinite
+     *      2: the orbits don't contract on average (contraction >= 1),
+     *         so points wander over their bounding box as noise
+     */
+    int i, funcnum;
+    double delta = 1e-7, dx, dy, dist, ratio, sumlog = 0, steps;
+    double pixel, diam, minx, maxx, miny, maxy;
+    double *window = frac -> window;
+    struct FracRNG *rng = &(frac -> rng);
+    double x = rnguniform(rng);
+    double y = rnguniform(rng);
+    double x2 = x + delta;
+    double y2 = y;
+    compilegenome(frac);
+    frac -> burnin = MAXBURNIN;
+    frac -> lipschitz = 0;
+    minx = maxx = x;
+    miny = maxy = y;
+    for (i = 0; i < HEALTHSTEPS; i++){
+        funcnum = pickfunc(frac, rnguniform(rng));
+        mapfunc(&x, &y, &(frac -> maps[funcnum]));
+        mapfunc(&x2, &y2, &(frac -> maps[funcnum]));
+        if (!(fabs(x) < DIVERGEBOUND && fabs(y) < DIVERGEBOUND)) return 1;
+        if (x < minx) minx = x;
+        if (x > maxx) maxx = x;
+        if (y < miny) miny = y;
+        if (y > maxy) maxy = y;
+        dx = x2 - x;
+        dy = y2 - y;
+        dist = sqrt(dx*dx + dy*dy);
+        ratio = dist/delta;
+        if (!(ratio > 1e-12)){
+            //both orbits landed on the same point, start the second again
+            ratio = 1e-12;
+            dx = delta;
+            dy = 0;
+            dist = delta;
+        }
+        if (ratio > frac -> lipschitz) frac -> lipschitz = ratio;
+        sumlog += log(ratio);
+        x2 = x + dx*delta/dist;
+        y2 = y + dy*delta/dist;
+    }
+    frac -> contraction = exp(sumlog/HEALTHSTEPS);
+    if (!(frac -> contraction < 1)) return 2;
+    pixel = (window[1] - window[0])/frac -> width;
+    if ((window[3] - window[2])/frac -> height < pixel) pixel = (window[3] - window[2])/frac -> height;
+    diam = sqrt((maxx - minx)*(maxx - minx) + (maxy - miny)*(maxy - miny));
+    steps = (diam > pixel) ? 2*log(pixel/diam)/log(frac -> contraction) : 0;
+    if (steps < MAXBURNIN) frac -> burnin = (steps > MINBURNIN) ? (int)ceil(steps) : MINBURNIN;
+    return 0;
+}
+
+void defaultpilot(struct PilotOptions *pilot){
+    /* This function sets the default limits for pilot renders */
+    pilot -> numpoints    = 4000;   //points in the pilot render
+    pilot -> res          = 64;     //the pilot is res x res pixels (at most PILOTMAXRES)
+    pilot -> maxtries     = 20;     //genomes tried before keeping one that fails
+    pilot -> maxoutside   = 0.02;   //fraction of points allowed outside the window
+    pilot -> minfill      = 0.005;  //fraction of pilot pixels that have to be lit
+    pilot -> maxfill      = 0.6;    //fraction of pilot pixels that can be lit
+    pilot -> minextent    = 0.1;    //smallest width and height of the lit pixels,
+                                    //as a fraction of the window
+    pilot -> maxoffcentre = 0.6;    //furthest the centroid can be from the centre,
+                                    //as a fraction of half the window
+    pilot -> mindim       = 0.9;    //range of the estimated dimension
+    pilot -> maxdim       = 1.95;
+    return;
+}
+
+int pilotfrac(struct Fractal *frac, struct PilotOptions *pilot){
+    /* This function renders a fractal with only a few points
+     * at a low resolution to check if it is worth rendering
+     * in full. It returns 0 if the fractal meets all the 
+     * limits in pilot, and otherwise returns which limit it 
+     * failed:
+     *      1: too many points outside of the window (or NaN)
+     *      2: too few pixels lit (collapsed to a few points)
+     *      3: too many pixels lit (a blob)
+     *      4: the lit pixels are too narrow or too short
+     *      5: the centroid is too far from the centre
+     *      6: the estimated dimension is out of range
+     * The fractal's pixel map is not used.
+     */
+    unsigned char grid[PILOTMAXRES*PILOTMAXRES];
+    int i, funcnum, cx, cy;
+    int res = (pilot -> res < PILOTMAXRES) ? pilot -> res : PILOTMAXRES;
+    int outside = 0;
+    int lit = 0;
+    int minx = res, maxx = -1, miny = res, maxy = -1;
+    double sumx = 0, sumy = 0, fx, fy, dim;
+    double *window = frac -> window;
+    struct FracRNG *rng = &(frac -> rng);
+    double x = rnguniform(rng);
+    double y = rnguniform(rng);
+    compilegenome(frac);
+    memset(grid, 0, res*res);
+    for (i = 0; i < 100; i++){
+        mapfunc(&x, &y, &(frac -> maps[rngint(rng, frac -> numfuncs)]));
+    }
+    for (i = 0; i < pilot -> numpoints; i++){
+        funcnum = pickfunc(frac, rnguniform(rng));
+        mapfunc(&x, &y, &(frac -> maps[funcnum]));
+        fx = (x - window[0])/(window[1] - window[0])*res;
+        fy = (window[3] - y)/(window[3] - window[2])*res;
+        if (!(fx >= 0 && fx < res && fy >= 0 && fy < res)){
+            outside++;
+            if (x != x || y != y || fabs(x) > 1e10 || fabs(y) > 1e10) return 1;
+            continue;
+        }
+        cx = (int)fx;
+        cy = (int)fy;
+        if (grid[cy*res + cx] == 0){
+            grid[cy*res + cx] = 1;
+            lit++;
+            sumx += cx;
+            sumy += cy;
+            if (cx < minx) minx = cx;
+            if (cx > maxx) maxx = cx;
+            if (cy < miny) miny = cy;
+            if (cy > maxy) maxy = cy;
+        }
+    }
+    if (outside > pilot -> maxoutside * pilot -> numpoints) return 1;
+    if (lit == 0 || lit < pilot -> minfill * res * res) return 2;
+    if (lit > pilot -> maxfill * res * res) return 3;
+    if ((maxx - minx + 1) < pilot -> minextent * res || 
+        (maxy - miny + 1) < pilot -> minextent * res) return 4;
+    if (fabs(sumx/lit - res/2.) > pilot -> maxoffcentre * res/2. ||
+        fabs(sumy/lit - res/2.) > pilot -> maxoffcentre * res/2.) return 5;
+    dim = log((double)lit)/log((double)res);
+    if (dim < pilot -> mindim || dim > pilot -> maxdim) return 6;
+    return 0;
 }
 
 void dimension(struct Fractal *frac){
-    /* This function calculates an estimate of the
-     * fractal dimension for a fractal, based on its
-     * corresponding number of pixels, and stores it
-     * in the fractal struct.
+    /* This function calculates an estimate of the fractal 
+     * dimension for a fractal by box counting, and stores it in 
+     * the fractal struct along with how well the boxes fit a 
+     * line, frac -> dimfit (R^2, 1 is a perfect fit).
+     *
+     * The pixel map is reduced to a pyramid of occupancy maps, 
+     * each made of the 2x2 blocks of the one before it, so that
+     * level k has boxes of 2^k x 2^k pixels. Level 1 is built in
+     * a single pass over the pixel map and each level after that
+     * is built in place from the last one in frac -> boxes, so
+     * the fractal is never rendered again. The dimension is then
+     * the slope of log(boxes lit) against log(1/box size), fitted
+     * over the levels with at least MINBOXES boxes across.
      */
-    frac -> dimension = (log(((double)frac -> numb))/log(((double)WIDTH)));
+    int i, j, k, w, h, nw, nh, count;
+    int width = frac -> width, height = frac -> height;
+    int numlevels = 0;
+    double logn[32], logs[32];
+    unsigned char *bm = frac -> bm;
+    unsigned char *boxes = frac -> boxes;
+
+    /* level 0 and level 1 */
+    count = 0;
+    nw = (width + 1)/2;
+    nh = (height + 1)/2;
+    memset(boxes, 0, nw*nh);
+    for (i = 0; i < height; i++){
+        for (j = 0; j < width; j++){
+            if (bm[i*width + j] != BLANKPIXEL){
+                count++;
+                boxes[(i/2)*nw + j/2] = 1;
+            }
+        }
+    }
+    if (count == 0){
+        frac -> dimension = 0;
+        frac -> dimfit = 0;
+        return;
+    }
+    logn[numlevels] = log((double)count);
+    logs[numlevels] = 0;
+    numlevels++;
+
+    /* levels 1 and up */
+    w = nw;
+    h = nh;
+    for (k = 1; w >= MINBOXES && h >= MINBOXES; k++){
+        count = 0;
+        for (i = 0; i < w*h; i++) count += boxes[i];
+        logn[numlevels] = log((double)count);
+        logs[numlevels] = k*log(2.);
+        numlevels++;
+        nw = (w + 1)/2;
+        nh = (h + 1)/2;
+        for (i = 0; i < nh; i++){
+            for (j = 0; j < nw; j++){
+                unsigned char b = boxes[(2*i)*w + 2*j];
+                if (2*j + 1 < w)                 b |= boxes[(2*i)*w + 2*j + 1];
+                if (2*i + 1 < h)                 b |= boxes[(2*i + 1)*w + 2*j];
+                if (2*j + 1 < w && 2*i + 1 < h)  b |= boxes[(2*i + 1)*w + 2*j + 1];
+                boxes[i*nw + j] = b;
+            }
+        }
+        w = nw;
+        h = nh;
+    }
+
+    /* least squares fit of log(count) = -dimension*log(size) + c */
+    double mx = 0, my = 0, sxx = 0, sxy = 0, syy = 0;
+    for (k = 0; k < numlevels; k++){
+        mx += logs[k]/numlevels;
+        my += logn[k]/numlevels;
+    }
+    for (k = 0; k < numlevels; k++){
+        sxx += (logs[k] - mx)*(logs[k] - mx);
+        sxy += (logs[k] - mx)*(logn[k] - my);
+        syy += (logn[k] - my)*(logn[k] - my);
+    }
+    if (numlevels < 2 || sxx == 0){
+        frac -> dimension = 0;
+        frac -> dimfit = 0;
+        return;
+    }
+    frac -> dimension = -sxy/sxx;
+    frac -> dimfit = (syy > 0) ? sxy*sxy/(sxx*syy) : 1;
     return;
 }
 
@@ -47,19 +325,18 @@ void stddev(struct Fractal *frac){
      * pixels corresponding to a fractal, in both the x and y 
      * direction, based on the image of the fractal. It then
      * stores these values in the fractal struct.
+     *
+     * The sums needed are kept in frac -> stats as pixels are
+     * drawn, so the image doesn't have to be scanned again.
      */
-    int i,j;
-    double stddevx = 0;
-    double stddevy = 0;
-    for (i = 0; i < HEIGHT; i++){
-        for (j = 0; j < WIDTH; j++){
-            if ((frac -> bm[i][j]) == 0){
-                stddevx += (j - frac -> avgx) * (j - frac -> avgx);
-                stddevy += (i - frac -> avgy) * (i - frac -> avgy);
-            }
-        }
+    struct FracStats *stats = &(frac -> stats);
+    long double n = stats -> numb;
+    if (stats -> numb < 2){
+        frac -> stddevx = 0;
+        frac -> stddevy = 0;
+        return;
     }
-    frac -> stddevx = sqrt(stddevx/((double)(frac -> numb -1)));
-    frac -> stddevy = sqrt(stddevy/((double)(frac -> numb -1)));
+    frac -> stddevx = sqrt((double)((stats -> sumxx - (long double)stats -> sumx*stats -> sumx/n)/(n - 1)));
+    frac -> stddevy = sqrt((double)((stats -> sumyy - (long double)stats -> sumy*stats -> sumy/n)/(n - 1)));
     return;
 }
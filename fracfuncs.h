@@ -4,6 +4,18 @@
  * FILE NAME: fracfuncs.h
  */
 struct Fractal;
-struct Fractal * makerandfrac(int numpoints, int numfuncs, int *restrictions, int numrestrictions, int disperse, double *window);
+struct PilotOptions{
+        /* Limits a fractal has to meet in a low resolution pilot render
+         * (see pilotfrac) before it is rendered in full
+         */
+        int numpoints, res, maxtries;
+        double maxoutside, minfill, maxfill, minextent, maxoffcentre, mindim, maxdim;
+};
+
+struct Fractal * makerandfrac(int numpoints, int numfuncs, int *restrictions, int numrestrictions, int disperse, double *window, uint64_t seed, int fracnum);
+void fillrandfrac(struct Fractal *frac, int *restrictions, int numrestrictions, int disperse, double *window, uint64_t seed, int fracnum);
+int checkorbit(struct Fractal *frac);
+void defaultpilot(struct PilotOptions *pilot);
+int pilotfrac(struct Fractal *frac, struct PilotOptions *pilot);
 void dimension(struct Fractal *frac);
 void stddev(struct Fractal *frac);
@@ -0,0 +1,387 @@
+/* FILE NAME: genargs.c
+ *
+ * This file contains the options of generatedata when it is 
+ * run in batch mode, without any prompts. Options are given 
+ * as flags, eg. --count 1000, or as lines of a config file
+ * named with --config, eg. count 1000, with # starting a 
+ * comment. Later options override earlier ones.
+ *
+ * With --shard k/N, the fractals numbered first to 
+ * first+count-1 are split into N equal ranges and only the
+ * kth one (counting from 0) is generated, into the directory
+ * partk/ inside the given directory. Since each fractal only
+ * depends on the seed and its number, the N parts can be run
+ * anywhere and merged with mergedb into the same database
+ * a single run would have made.
+ *
+ * Each --view adds another image of every fractal, drawn from
+ * the same points at its own resolution and optionally its own
+ * window, eg. --view 128x128 or --view 1024x1024@-1,1,-1,1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include "Fractals.h"
+#include "fracfuncs.h"
+#include "PNGio.h"
+#include "vecio.h"
+#include "density.h"
+#include "gendb.h"
+#include "genargs.h"
+
+void defaultoptions(struct GenOptions *opts){
+    /* This function sets every option of a run to its default */
+    opts -> numtogenerate   = 100;
+    opts -> dirname         = NULL;
+    opts -> numpoints       = 1000000;
+    opts -> minpoints       = 0;           //unset, so adaptive is off (see checkoptions)
+    opts -> adaptive        = 0;
+    opts -> pointbatch      = POINTBATCH;
+    opts -> mincoverage     = MINCOVERAGE;
+    opts -> numfuncs        = 4;
+    opts -> window[0] = opts -> window[2] = -3;
+    opts -> window[1] = opts -> window[3] = 3;
+    opts -> width           = WIDTH;
+    opts -> height          = HEIGHT;
+    opts -> numviews        = 0;
+    opts -> density         = 0;
+    opts -> densitycounts   = 32;
+    opts -> tonemap         = DENSITYLOG;
+    opts -> gamma           = 1;
+    opts -> restrictions    = ivecmem(MAXRESTRICTIONS);
+    opts -> numrestrictions = 0;
+    opts -> disperse        = 0;
+    opts -> usepilot        = 0;
+    opts -> health          = 0;
+    opts -> engine          = ENGINECHAOS;
+    opts -> supersample     = 0;
+    opts -> fandepth        = 0;
+    defaultpilot(&(opts -> pilot));
+    opts -> numthreads      = 1;
+    opts -> renderthreads   = 1;
+    opts -> kernels         = KERNELVEC;
+    opts -> validate        = 0;
+    opts -> probpolicy      = PROBSEQUAL;
+    opts -> sampler         = SAMPLERREJECT;
+    opts -> minscale        = 0;
+    opts -> maxscale        = 1;
+    opts -> encodethreads   = 0;
+    defaultpngsettings(&(opts -> png));
+    opts -> coloured        = 1;
+    opts -> pershard        = 0;
+    opts -> writetext       = 1;
+    opts -> seed            = time(NULL);
+    opts -> seedgiven       = 0;
+    opts -> firstfrac       = 0;
+    opts -> shard           = 0;
+    opts -> numshards       = 0;    //0 appends to the database in dirname
+    return;
+}
+
+int readres(char *value, int *width, int *height){
+    /* This function reads a resolution given as WxH, or as N for 
+     * a square image. It returns 1 if it doesn't make sense, or 
+     * isn't one resizefrac takes.
+     */
+    int num = sscanf(value, "%dx%d", width, height);
+    if (num == 1) *height = *width;
+    return (num < 1 || *width < MINRES || *height < MINRES || (long long)*width * *height > INT_MAX);
+}
+
+int setpilotoption(struct PilotOptions *pilot, char *key, char *value){
+    /* This function sets the pilot limit named key, without its 
+     * pilot- prefix (see defaultpilot and usage in readargs). It 
+     * returns 1 if the key isn't one or the value doesn't make sense.
+     */
+    char *end;
+    double x = strtod(value, &end);
+    int isnum = (*end == '\0' && end != value);
+    if (strcmp(key, "fill") == 0){
+        if (sscanf(value, "%lf,%lf", &(pilot -> minfill), &(pilot -> maxfill)) != 2) return 1;
+        return !(pilot -> minfill >= 0 && pilot -> minfill <= pilot -> maxfill);
+    }
+    if (strcmp(key, "dim") == 0){
+        if (sscanf(value, "%lf,%lf", &(pilot -> mindim), &(pilot -> maxdim)) != 2) return 1;
+        return !(pilot -> mindim <= pilot -> maxdim);
+    }
+    if (isnum == 0 || !(x >= 0)) return 1;
+    if (strcmp(key, "points") == 0)         pilot -> numpoints = (x < INT_MAX) ? (int)x : INT_MAX;
+    else if (strcmp(key, "res") == 0)       pilot -> res = (x < INT_MAX) ? (int)x : INT_MAX;
+    else if (strcmp(key, "tries") == 0)     pilot -> maxtries = (x < INT_MAX) ? (int)x : INT_MAX;
+    else if (strcmp(key, "outside") == 0)   pilot -> maxoutside = x;
+    else if (strcmp(key, "extent") == 0)    pilot -> minextent = x;
+    else if (strcmp(key, "offcentre") == 0) pilot -> maxoffcentre = x;
+    else return 1;
+    return (pilot -> numpoints < 1 || pilot -> res < 2 || pilot -> res > PILOTMAXRES || pilot -> maxtries < 1);
+}
+
+int setoption(struct GenOptions *opts, char *key, char *value){
+    /* This function sets the option named key (see usage in readargs)
+     * from the text value. It returns 1 if the key isn't an option 
+     * or the value doesn't make sense, and 0 otherwise.
+     */
+    char *end, copy[FILENAMELEN];
+    long long num = strtoll(value, &end, 10);
+    int isnum = (*end == '\0' && end != value);
+    int len;
+    if (strcmp(key, "dir") == 0){
+        if (strlen(value) >= FILENAMELEN - 32) return 1;
+        opts -> dirname = strdup(value);
+        return 0;
+    }
+    if (strcmp(key, "window") == 0){
+        snprintf(copy, FILENAMELEN, "%s", value);
+        if (strchr(copy, ',') == NULL) return 1;
+        dstrtovec(copy, opts -> window, &len);
+        return (len != 4);
+    }
+    if (strcmp(key, "restrict") == 0){
+        snprintf(copy, FILENAMELEN, "%s", value);
+        for (len = 0, end = copy; *end != '\0'; end++) len += (*end == ',');
+        if (len >= MAXRESTRICTIONS) return 1;
+        istrtovec(copy, opts -> restrictions, &(opts -> numrestrictions));
+        return 0;
+    }
+    if (strcmp(key, "res") == 0){
+        return readres(value, &(opts -> width), &(opts -> height));
+    }
+    if (strcmp(key, "view") == 0){
+        struct FracView *view = &(opts -> views[opts -> numviews]);
+        if (opts -> numviews >= MAXVIEWS) return 1;
+        snprintf(copy, FILENAMELEN, "%s", value);
+        end = strchr(copy, '@');
+        view -> samewindow = (end == NULL);
+        if (end != NULL){
+            *end = '\0';
+            if (strchr(end + 1, ',') == NULL) return 1;
+            dstrtovec(end + 1, view -> window, &len);
+            if (len != 4) return 1;
+        }
+        if (readres(copy, &(view -> width), &(view -> height)) != 0) return 1;
+        view -> bm = NULL;
+        opts -> numviews++;
+        return 0;
+    }
+    if (strcmp(key, "shard") == 0){
+        if (sscanf(value, "%d/%d", &(opts -> shard), &(opts -> numshards)) != 2) return 1;
+        return (opts -> numshards < 1 || opts -> shard < 0 || opts -> shard >= opts -> numshards);
+    }
+    if (strcmp(key, "scales") == 0){
+        if (sscanf(value, "%lf,%lf", &(opts -> minscale), &(opts -> maxscale)) != 2) return 1;
+        return !(opts -> minscale >= 0 && opts -> minscale <= opts -> maxscale && opts -> maxscale <= 1 &&
+                 (opts -> maxscale < 1 || opts -> minscale < opts -> maxscale));  //singular values below 1
+    }
+    if (strncmp(key, "pilot-", 6) == 0){
+        return setpilotoption(&(opts -> pilot), &(key[6]), value);
+    }
+    if (strcmp(key, "mincoverage") == 0){
+        opts -> mincoverage = strtod(value, &end);
+        return (*end != '\0' || !(opts -> mincoverage >= 0));
+    }
+    if (strcmp(key, "gamma") == 0){
+        opts -> gamma = strtod(value, &end);
+        return (*end != '\0' || !(opts -> gamma > 0));
+    }
+    if (isnum == 0) return 1;
+    if (strcmp(key, "seed") == 0){
+        opts -> seed = num;
+        opts -> seedgiven = 1;
+        return 0;
+    }
+    if (num > INT_MAX || num < INT_MIN) return 1;   //point counts and the rest are ints
+    if (strcmp(key, "count") == 0)          opts -> numtogenerate = num;
+    else if (strcmp(key, "first") == 0)     opts -> firstfrac = num;
+    else if (strcmp(key, "points") == 0)    opts -> numpoints = num;
+    else if (strcmp(key, "minpoints") == 0) opts -> minpoints = num;
+    else if (strcmp(key, "pointbatch") == 0) opts -> pointbatch = num;
+    else if (strcmp(key, "funcs") == 0)     opts -> numfuncs = num;
+    else if (strcmp(key, "disperse") == 0)  opts -> disperse = num;
+    else if (strcmp(key, "pilot") == 0)     opts -> usepilot = num;
+    else if (strcmp(key, "threads") == 0)   opts -> numthreads = num;
+    else if (strcmp(key, "render") == 0)    opts -> renderthreads = num;
+    else if (strcmp(key, "kernels") == 0)   opts -> kernels = num;
+    else if (strcmp(key, "validate") == 0)  opts -> validate = num;
+    else if (strcmp(key, "probs") == 0)     opts -> probpolicy = num;
+    else if (strcmp(key, "sampler") == 0)   opts -> sampler = num;
+    else if (strcmp(key, "health") == 0)    opts -> health = num;
+    else if (strcmp(key, "engine") == 0)    opts -> engine = num;
+    else if (strcmp(key, "supersample") == 0) opts -> supersample = num;
+    else if (strcmp(key, "depth") == 0)     opts -> fandepth = num;
+    else if (strcmp(key, "encoders") == 0)  opts -> encodethreads = num;
+    else if (strcmp(key, "level") == 0)     opts -> png.level = num;
+    else if (strcmp(key, "strategy") == 0)  opts -> png.strategy = num;
+    else if (strcmp(key, "filters") == 0)   opts -> png.filters = num;
+    else if (strcmp(key, "encoding") == 0)  opts -> png.encoding = num;
+    else if (strcmp(key, "coloured") == 0)  opts -> coloured = num;
+    else if (strcmp(key, "pershard") == 0)  opts -> pershard = num;
+    else if (strcmp(key, "text") == 0)      opts -> writetext = num;
+    else if (strcmp(key, "density") == 0)   opts -> density = num;
+    else if (strcmp(key, "counts") == 0)    opts -> densitycounts = num;
+    else if (strcmp(key, "tonemap") == 0)   opts -> tonemap = num;
+    else return 1;
+    return (opts -> density != 0 && opts -> density != 8 && opts -> density != 16)||
+           (opts -> kernels < KERNELLIBM || opts -> kernels > KERNELFAST)||
+           (opts -> probpolicy != PROBSEQUAL && opts -> probpolicy != PROBSCONTRACTION)||
+           (opts -> sampler != SAMPLERREJECT && opts -> sampler != SAMPLERDIRECT)||
+           (opts -> engine < ENGINECHAOS || opts -> engine > ENGINEFANOUT)||
+           (opts -> fandepth < 0)||
+           (opts -> pointbatch < 1)||
+           (opts -> supersample < 0 || opts -> supersample > MAXSUPERSAMPLE)||
+           (opts -> densitycounts != 16 && opts -> densitycounts != 32)||
+           checkpngsettings(&(opts -> png));
+}
+
+void readconfig(struct GenOptions *opts, char *filename){
+    /* This function sets the options in a config file, one per line
+     * as key value (or key = value)
+     */
+    char line[256], key[64], value[192];
+    int linenum = 0;
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL){
+        fprintf(stderr, "Failed to open file (readconfig): %s\n", filename);
+        exit(1);
+    }
+    while (fgets(line, 256, fp) != NULL){
+        linenum++;
+        if (strchr(line, '#') != NULL) *strchr(line, '#') = '\0';
+        for (char *c = line; *c != '\0'; c++) if (*c == '=') *c = ' ';
+        if (sscanf(line, "%63s %191s", key, value) < 1) continue;
+        if (sscanf(line, "%63s %191s", key, value) != 2 || setoption(opts, key, value) != 0){
+            fprintf(stderr, "Error, bad option on line %d of %s: %s", linenum, filename, line);
+            exit(1);
+        }
+    }
+    fclose(fp);
+    return;
+}
+
+void usage(char *name){
+    /* This function prints the batch mode options and exits */
+    fprintf(stderr, "usage: %s --dir directory/ [options], or with no options for prompts\n"
+            "  --config file      read options from a file, one 'option value' per line\n"
+            "  --count n          number of fractals to generate (100)\n"
+            "  --points n         points plotted for each fractal (1000000)\n"
+            "  --minpoints n      stop early once no new pixels are filled in, after n points,\n"
+            "                     or 0 to always plot every point (0)\n"
+            "  --pointbatch n     with --minpoints, points between checks for new pixels (%d)\n"
+            "  --mincoverage x    with --minpoints, stop once a batch lights at most x new\n"
+            "                     pixels per point (%g)\n"
+            "  --funcs n          functions in each IFS (4)\n"
+            "  --window a,b,c,d   viewing window minx,maxx,miny,maxy (-3,3,-3,3)\n"
+            "  --res WxH          resolution of the images, or N for NxN, at least %d (640x640)\n"
+            "  --view WxH[@a,b,c,d]  also draw each fractal at another resolution,\n"
+            "                     optionally in another window (up to %d times)\n"
+            "  --restrict t,...   function types not to use\n"
+            "  --disperse n       0, 1 or 2, as in the prompts (0)\n"
+            "  --probs 0|1        0 - pick functions equally often, 1 - in proportion\n"
+            "                     to how much they shrink areas (0)\n"
+            "  --sampler 0|1      0 - draw functions until they are contractive, 1 - draw\n"
+            "                     contractive functions directly, without retries (0)\n"
+            "  --scales lo,hi     with --sampler 1, the range the singular values of each\n"
+            "                     function are drawn from, 0 <= lo <= hi <= 1 and\n"
+            "                     lo < hi if hi is 1, so they are below 1 (0,1)\n"
+            "  --pilot 0|1        skip degenerate fractals with pilot renders (0)\n"
+            "  --pilot-points n   points in each pilot render (4000)\n"
+            "  --pilot-res n      pilot renders are n x n pixels, 2 to %d (64)\n"
+            "  --pilot-tries n    genomes tried for each fractal (20)\n"
+            "  --pilot-outside f  largest fraction of pilot points outside the window (0.02)\n"
+            "  --pilot-fill lo,hi smallest and largest fraction of pilot pixels lit (0.005,0.6)\n"
+            "  --pilot-extent f   smallest width and height of the lit pixels, as a fraction\n"
+            "                     of the window (0.1)\n"
+            "  --pilot-offcentre f  furthest the centroid can be from the centre, as a\n"
+            "                     fraction of half the window (0.6)\n"
+            "  --pilot-dim lo,hi  range of the pilot's estimated dimension (0.9,1.95)\n"
+            "  --health 0|1       skip fractals whose orbits diverge or don't contract,\n"
+            "                     and size the burn-in from how fast they contract (0)\n"
+            "  --engine 0|1|2     0 - chaos game, 1 - iterate the functions on the lit\n"
+            "                     pixels until no new ones are lit, filling in with up to\n"
+            "                     --points points of the chaos game (see README),\n"
+            "                     2 - apply every composition of the functions to seeds (0)\n"
+            "  --supersample n    with --engine 1, cells across each pixel, 1 to %d, or 0\n"
+            "                     to pick from how much the functions stretch (0)\n"
+            "  --depth n          with --engine 2, how many functions are composed, or 0\n"
+            "                     for as many as fit a batch of %d points (0)\n"
+            "  --threads n        threads generating fractals (1)\n"
+            "  --render n         threads plotting the points of each fractal (1)\n"
+            "  --kernels n        cos, sin and tanh from 0 - libm, 1 - vecmath.c,\n"
+            "                     2 - faster approximations in vecmath.c (1)\n"
+            "  --validate 0|1     only compare images drawn with --kernels and libm,\n"
+            "                     without writing anything (0)\n"
+            "  --encoders n       threads writing pngs (0)\n"
+            "  --level n          png compression level, -1 for the default (-1)\n"
+            "  --strategy n       zlib strategy, 0 - default, 1 - filtered, 2 - huffman only,\n"
+            "                     3 - rle, 4 - fixed, -1 to leave it to libpng (-1)\n"
+            "  --filters n        png row filters to try, the sum of 8 - none, 16 - sub,\n"
+            "                     32 - up, 64 - average, 128 - paeth, -1 to leave it to libpng (-1)\n"
+            "  --encoding n       0 - 24 bit colour pngs, 1 - compact pngs (1)\n"
+            "  --coloured 0|1     0 to colour by function, 1 for black (1)\n"
+            "  --pershard n       fractals per shard file, 0 for pngs (0)\n"
+            "  --text 0|1         also write fracdata.dat (1)\n"
+            "  --density 0|8|16   also write density pngs of that many bits, counting\n"
+            "                     the points on each pixel (0)\n"
+            "  --counts 16|32     bits of each count in the density histograms (32)\n"
+            "  --tonemap 0|1      0 - log(1+count), 1 - count, scaled to the densest pixel (0)\n"
+            "  --gamma g          gamma applied after the tone map (1)\n"
+            "  --seed s           seed for the random number generator (the time)\n"
+            "  --shard k/N        only generate part k of N, into directory/partk/\n"
+            "  --first n          number of the first fractal when using --shard (0)\n", name, POINTBATCH, MINCOVERAGE, MINRES, MAXVIEWS, PILOTMAXRES, MAXSUPERSAMPLE, FANOUTBATCH);
+    exit(1);
+}
+
+void checkoptions(struct GenOptions *opts){
+    /* This function checks the options that depend on each other or 
+     * weren't checked as they were set, once they are all read, and
+     * turns on adaptive stopping if minpoints is set below numpoints.
+     * It warns about views with smaller pixels than the main image 
+     * with --engine 1, which only lights points as dense as its cells.
+     */
+    if (opts -> numtogenerate < 1 || opts -> numpoints < 1 || opts -> numfuncs < 1 || 
+        opts -> numthreads < 1 || opts -> renderthreads < 1){
+        fprintf(stderr, "Error, the number of fractals, points, functions and threads must be at least 1\n");
+        exit(1);
+    }
+    if (opts -> minpoints < 0 || opts -> minpoints > opts -> numpoints){
+        fprintf(stderr, "Error, minpoints must be from 0 to the number of points (%d)\n", opts -> numpoints);
+        exit(1);
+    }
+    opts -> adaptive = (opts -> minpoints > 0 && opts -> minpoints < opts -> numpoints);
+    if (checkpngsettings(&(opts -> png)) != 0){
+        fprintf(stderr, "Error, the png level must be -1 to 9, the strategy -1 to 4, the filters -1\n"
+                        "or a sum of 8, 16, 32, 64 and 128, and the encoding 0 or 1\n");
+        exit(1);
+    }
+    for (int i = 0; i < opts -> numviews && opts -> engine == ENGINESET; i++){
+        struct FracView *view = &(opts -> views[i]);
+        double *window = view -> samewindow ? opts -> window : view -> window;
+        if ((window[1] - window[0])/view -> width  < (opts -> window[1] - opts -> window[0])/opts -> width ||
+            (window[3] - window[2])/view -> height < (opts -> window[3] - opts -> window[2])/opts -> height){
+            fprintf(stderr, "Warning, --engine 1 only lights as many points as the main image has cells,\n"
+                            "so view %d (%dx%d) will be sparse, see README\n", i, view -> width, view -> height);
+        }
+    }
+    return;
+}
+
+void readargs(int argc, char *argv[], struct GenOptions *opts){
+    /* This function sets the options given on the command line */
+    for (int i = 1; i < argc; i++){
+        if (strncmp(argv[i], "--", 2) != 0 || i + 1 >= argc) usage(argv[0]);
+        if (strcmp(argv[i], "--config") == 0) readconfig(opts, argv[i+1]);
+        else if (setoption(opts, &(argv[i][2]), argv[i+1]) != 0){
+            fprintf(stderr, "Error, bad option: %s %s\n", argv[i], argv[i+1]);
+            usage(argv[0]);
+        }
+        i++;
+    }
+    if (opts -> dirname == NULL && opts -> validate == 0) usage(argv[0]);
+    if (opts -> numshards > 0 && opts -> seedgiven == 0){
+        fprintf(stderr, "Error, every part of a sharded run needs the same --seed\n");
+        exit(1);
+    }
+    return;
+}
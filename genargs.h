@@ -0,0 +1,11 @@
+/* FILE NAME: genargs.h */
+struct GenOptions;
+struct PilotOptions;
+
+int readres(char *value, int *width, int *height);
+void defaultoptions(struct GenOptions *opts);
+int setpilotoption(struct PilotOptions *pilot, char *key, char *value);
+int setoption(struct GenOptions *opts, char *key, char *value);
+void readconfig(struct GenOptions *opts, char *filename);
+void checkoptions(struct GenOptions *opts);
+void readargs(int argc, char *argv[], struct GenOptions *opts);
@@ -0,0 +1,716 @@
+/* FILE NAME: gendb.c
+ *
+ * This file contains the functions used by generatedata
+ * to fill a database with fractals, either one at a time
+ * or with a pool of worker threads. In both cases fractal
+ * numbers are handed out in order and the rows of 
+ * fracdata.dat are written in order, so the database 
+ * looks the same however it was generated. Since every
+ * fractal gets its own random number generator (see rng.c),
+ * the fractals themselves are also the same.
+ *
+ * If opts -> encodethreads is positive, pngs are handed to a
+ * pool of encoder threads (see pngqueue.c) instead of being
+ * written by the thread that generated the fractal. If 
+ * opts -> pershard is positive, images go into shard files 
+ * (see shard.c) in order instead of pngs. The metadata of every
+ * fractal goes into the binary database (see fracdb.c), and
+ * into fracdata.dat as well if it is open.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "Fractals.h"
+#include "fracfuncs.h"
+#include "PNGio.h"
+#include "pngqueue.h"
+#include "shard.h"
+#include "fracdb.h"
+#include "density.h"
+#include "gendb.h"
+
+void writefracrow(FILE *fp, struct Fractal *frac, int fracnum){
+    /* This function writes the row of fracdata.dat for a fractal:
+     * fractal number, numfuncs, numpoints, numb, avgx, avgy, stddevx, 
+     * stddevy, dimension, dimfit, genome 
+     * where numpoints is the number of points actually generated and
+     * dimfit is the R^2 of the box counting fit for the dimension
+     */
+    int j, k;
+    int params = 0;
+    fprintf(fp, "%d\t%d\t%d\t%d\t%.15lf\t%.15lf\t%.15lf\t%.15lf\t%.15lf\t%.15lf\t",
+            fracnum, frac->numfuncs, frac->pointsused, frac->numb, 
+            frac->avgx, frac->avgy, frac->stddevx, frac->stddevy, frac -> dimension, frac -> dimfit);
+    for (j = 0; j < frac -> numfuncs; j++){
+        for (k = 0; k < multindjump(frac->genome[3][j]); k++){
+            fprintf(fp, "%.15lf\t", frac -> genome[0][params + k]);
+        }
+        params += multindjump(frac->genome[3][j]);
+    }
+    params = 0;
+    for (j = 0; j < frac -> numfuncs; j++){
+        for (k = 0; k < addindjump(frac->genome[3][j]); k++){
+            fprintf(fp, "%.15lf\t", frac -> genome[1][params + k]);
+        }
+        params += addindjump(frac->genome[3][j]);
+    }
+    for (j = 0; j < frac -> numfuncs; j++){
+        fprintf(fp, "%.15lf\t", frac -> genome[2][j]);
+    }
+    for (j = 0; j < frac -> numfuncs-1; j++){
+        fprintf(fp, "%.15lf\t", frac -> genome[3][j]);
+    }
+    fprintf(fp, "%.15lf\n", frac -> genome[3][frac -> numfuncs -1]);
+    return;
+}
+
+int readfracrow(FILE *fp, struct Fractal *frac){
+    /* This function reads the next row of fracdata.dat (see writefracrow)
+     * into a fractal structure, reinitializing it if the row has a 
+     * different number of functions. It returns -1 at the end of the 
+     * file, 1 if the row is malformed and 0 otherwise.
+     *
+     * Rows written before dimfit was added have only 9 columns before
+     * the genome, with the centroid as whole pixels. These are read as
+     * well, with dimfit set to -1.
+     */
+    char *line = NULL, *pos, *end;
+    size_t cap = 0;
+    int len = 0, numfuncs, numstats = 10;
+    double vals[10 + 14*BLANKPIXEL];
+    if (getline(&line, &cap, fp) < 0){
+        free(line);
+        return -1;
+    }
+    pos = line;
+    while (len < 10 + 14*BLANKPIXEL){
+        vals[len] = strtod(pos, &end);
+        if (end == pos) break;
+        pos = end;
+        len++;
+    }
+    free(line);
+    numfuncs = (int)vals[1];
+    if (len < 10 || numfuncs < 1 || numfuncs >= BLANKPIXEL) return 1;
+    if (numfuncs != frac -> numfuncs){
+        int numpoints = frac -> numpoints, width = frac -> width, height = frac -> height;
+        freefrac(frac);
+        initializefrac(frac, numfuncs, numpoints);
+        resizefrac(frac, width, height);
+    }
+    if (unpackgenome(numfuncs, &(vals[10]), len - 10, frac -> genome) != 0){
+        numstats = 9;
+        if (unpackgenome(numfuncs, &(vals[9]), len - 9, frac -> genome) != 0) return 1;
+    }
+    frac -> fracnum    = (int)vals[0];
+    frac -> pointsused = (int)vals[2];
+    frac -> numb       = (int)vals[3];
+    frac -> avgx       = vals[4];
+    frac -> avgy       = vals[5];
+    frac -> stddevx    = vals[6];
+    frac -> stddevy    = vals[7];
+    frac -> dimension  = vals[8];
+    frac -> dimfit     = (numstats == 10) ? vals[9] : -1;
+    return 0;
+}
+
+int importtext(char *dirname, char *filepath){
+    /* This function adds the rows of fracdata.dat to the empty database
+     * in dirname, so a directory made before there was a database is 
+     * numbered on from its rows rather than from 0. Malformed rows are 
+     * skipped. It returns the number of rows added.
+     */
+    struct FracDBWriter *writer;
+    struct Fractal frac;
+    int ret, row, numadded = 0;
+    FILE *fp = fopen(filepath, "r");
+    if (fp == NULL) return 0;
+    writer = newdbwriter(dirname);
+    initializefrac(&frac, 1, 1);
+    for (row = 0; (ret = readfracrow(fp, &frac)) >= 0; row++){
+        if (ret == 1){
+            fprintf(stderr, "Skipping malformed row %d of %s\n", row, filepath);
+            continue;
+        }
+        frac.contraction = -1;
+        frac.lipschitz = -1;
+        dbappend(writer, &frac);
+        numadded++;
+    }
+    closedbwriter(writer);
+    freefrac(&frac);
+    fclose(fp);
+    return numadded;
+}
+
+struct Fractal * newcontexts(struct GenOptions *opts, int num){
+    /* This function allocates num fractal structures sized for the
+     * run. Fractals are built in these over and over (see buildfrac)
+     * so nothing is allocated per fractal.
+     */
+    struct Fractal *fracs;
+    if ((fracs = (struct Fractal *)malloc(num * sizeof(struct Fractal))) == NULL){
+        fprintf(stderr, "Malloc failed (newcontexts)\n");
+        exit(1);
+    }
+    for (int i = 0; i < num; i++){
+        initializefrac(&(fracs[i]), opts -> numfuncs, opts -> numpoints);
+        resizefrac(&(fracs[i]), opts -> width, opts -> height);
+        for (int j = 0; j < opts -> numviews; j++){
+            addview(&(fracs[i]), opts -> views[j].width, opts -> views[j].height, 
+                    opts -> views[j].samewindow ? NULL : opts -> views[j].window);
+        }
+        if (opts -> density){
+            fracs[i].density = newdensity(opts -> width, opts -> height, opts -> densitycounts);
+        }
+        fracs[i].adaptive = opts -> adaptive;
+        fracs[i].coloured = opts -> coloured;
+        fracs[i].renderthreads = opts -> renderthreads;
+        fracs[i].kernels = opts -> kernels;
+        fracs[i].probpolicy = opts -> probpolicy;
+        fracs[i].sampler = opts -> sampler;
+        fracs[i].minscale = opts -> minscale;
+        fracs[i].maxscale = opts -> maxscale;
+        if (opts -> adaptive) fracs[i].minpoints = opts -> minpoints;
+        fracs[i].pointbatch = opts -> pointbatch;
+        fracs[i].mincoverage = opts -> mincoverage;
+        if (opts -> usepilot) fracs[i].pilot = &(opts -> pilot);
+        fracs[i].health = opts -> health;
+        fracs[i].engine = opts -> engine;
+        fracs[i].supersample = opts -> supersample;
+        fracs[i].fandepth = opts -> fandepth;
+    }
+    return fracs;
+}
+
+void freecontexts(struct Fractal *fracs, int num){
+    /* This function frees fractal structures made by newcontexts */
+    for (int i = 0; i < num; i++){
+        freefrac(&(fracs[i]));
+    }
+    free(fracs);
+    return;
+}
+
+void buildfrac(struct Fractal *frac, struct GenOptions *opts, int fracnum){
+    /* This function makes a complete fractal in the fractal structure 
+     * frac: it generates it, calculates its properties and writes its 
+     * png, or queues it to be written, along with a png of each view 
+     * named eg. frac12_view0.png and its density png, frac12_density.png,
+     * if opts -> density is set. Only the row in fracdata.dat (and the
+     * images, when writing shards) is left to be written.
+     */
+    char fracname[FILENAMELEN];
+    struct FracView *view;
+    fillrandfrac(frac, opts -> restrictions, opts -> numrestrictions, opts -> disperse, 
+                 opts -> window, opts -> seed, fracnum);
+    stddev(frac);
+    dimension(frac);
+    if (opts -> density) tonemapdensity(frac -> density, opts -> density, opts -> tonemap, opts -> gamma);
+    if (opts -> shards != NULL) return;
+    snprintf(fracname, FILENAMELEN, "%sfrac%d.png", opts -> dirname, fracnum);
+    if (opts -> pngqueue != NULL){
+        pushpng(opts -> pngqueue, fracname, frac -> bm, frac -> width, frac -> height, 
+                frac -> coloured, frac -> numfuncs);
+    }
+    else {
+        WritePNGpixels(fracname, frac -> bm, frac -> width, frac -> height, 
+                       frac -> coloured, frac -> numfuncs, &(opts -> png));
+    }
+    for (int i = 0; i < frac -> numviews; i++){
+        view = &(frac -> views[i]);
+        snprintf(fracname, FILENAMELEN, "%sfrac%d_view%d.png", opts -> dirname, fracnum, i);
+        if (opts -> pngqueue != NULL){
+            pushpng(opts -> pngqueue, fracname, view -> bm, view -> width, view -> height, 
+                    frac -> coloured, frac -> numfuncs);
+        }
+        else {
+            WritePNGpixels(fracname, view -> bm, view -> width, view -> height, 
+                           frac -> coloured, frac -> numfuncs, &(opts -> png));
+        }
+    }
+    if (opts -> density){
+        snprintf(fracname, FILENAMELEN, "%sfrac%d_density.png", opts -> dirname, fracnum);
+        if (opts -> pngqueue != NULL){
+            pushgray(opts -> pngqueue, fracname, frac -> density -> gray, frac -> width, frac -> height, 
+                     opts -> density);
+        }
+        else {
+            WritePNGgray(fracname, frac -> density -> gray, frac -> width, frac -> height, 
+                         opts -> density, &(opts -> png));
+        }
+    }
+    return;
+}
+
+void startoutput(struct GenOptions *opts){
+    /* This function opens the database and sets up where the 
+     * images of a run go: shard files if opts -> pershard is positive, otherwise pngs, written 
+     * by encoder threads if there are any, with room for 
+     * opts -> queuesize pngs. Each view, and the density images, get
+     * their own series of shards, eg. shard1000_view0.frs and
+     * shard1000_density.frs.
+     */
+    char suffix[16];
+    int encoding = opts -> coloured ? SHARDBITS : SHARDBYTES;
+    size_t imagesize = (size_t)opts -> width*opts -> height;
+    opts -> pngqueue = NULL;
+    opts -> shards = NULL;
+    opts -> densityshards = NULL;
+    opts -> db = newdbwriter(opts -> dirname);
+    if (opts -> pershard > 0){
+        opts -> shards = newshardwriter(opts -> dirname, "", opts -> pershard, encoding, 
+                                        opts -> width, opts -> height);
+        for (int i = 0; i < opts -> numviews; i++){
+            snprintf(suffix, 16, "_view%d", i);
+            opts -> viewshards[i] = newshardwriter(opts -> dirname, suffix, opts -> pershard, encoding, 
+                                                   opts -> views[i].width, opts -> views[i].height);
+        }
+        if (opts -> density){
+            opts -> densityshards = newshardwriter(opts -> dirname, "_density", opts -> pershard, 
+                                                   (opts -> density == 16) ? SHARDGRAY16 : SHARDBYTES,
+                                                   opts -> width, opts -> height);
+        }
+    }
+    else if (opts -> encodethreads > 0){
+        for (int i = 0; i < opts -> numviews; i++){
+            if ((size_t)opts -> views[i].width*opts -> views[i].height > imagesize){
+                imagesize = (size_t)opts -> views[i].width*opts -> views[i].height;
+            }
+        }
+        if (opts -> density == 16 && 2*(size_t)opts -> width*opts -> height > imagesize){
+            imagesize = 2*(size_t)opts -> width*opts -> height;
+        }
+        opts -> pngqueue = newpngqueue(opts -> encodethreads, opts -> queuesize, imagesize, &(opts -> png));
+    }
+    return;
+}
+
+void stopoutput(struct GenOptions *opts){
+    /* This function waits for the queued pngs to be written and 
+     * stops the encoder threads, or finishes the last shard, and
+     * closes the database
+     */
+    if (opts -> pngqueue != NULL){
+        closepngqueue(opts -> pngqueue);
+        opts -> pngqueue = NULL;
+    }
+    if (opts -> shards != NULL){
+        closeshardwriter(opts -> shards);
+        opts -> shards = NULL;
+        for (int i = 0; i < opts -> numviews; i++){
+            closeshardwriter(opts -> viewshards[i]);
+            opts -> viewshards[i] = NULL;
+        }
+        if (opts -> densityshards != NULL) closeshardwriter(opts -> densityshards);
+        opts -> densityshards = NULL;
+    }
+    closedbwriter(opts -> db);
+    opts -> db = NULL;
+    return;
+}
+
+void commitfrac(FILE *fp, struct Fractal *frac, struct GenOptions *opts){
+    /* This function writes the record of a built fractal to the 
+     * database, its row to fracdata.dat if fp isn't NULL, and its 
+     * image to the current shard if there is one. The record and the 
+     * row are flushed, so a stopped run leaves whole ones (see generatedb). Fractals are 
+     * committed in order of their number.
+     */
+    dbappend(opts -> db, frac);
+    if (fp != NULL){
+        writefracrow(fp, frac, frac -> fracnum);
+        fflush(fp);
+    }
+    if (opts -> shards != NULL){
+        shardappend(opts -> shards, frac, frac -> bm);
+        for (int i = 0; i < frac -> numviews; i++){
+            shardappend(opts -> viewshards[i], frac, frac -> views[i].bm);
+        }
+        if (opts -> densityshards != NULL) shardappend(opts -> densityshards, frac, frac -> density -> gray);
+    }
+    return;
+}
+
+void printprogress(int i, int numtogenerate, int *pcomp){
+    /* This function prints the percentage of fractals generated 
+     * after the ith fractal has been written 
+     */
+    if (numtogenerate >= 100 && (i%((int)(numtogenerate/100.)) == 0)){
+        *pcomp += 1;
+        if (*pcomp < 10){
+            fprintf(stdout, "\rPercent Complete:\t%d%%", *pcomp);
+        }
+        else if (*pcomp < 100){
+            fprintf(stdout, "\rPercent Complete:\t\b%d%%", *pcomp);
+        }
+        else {
+            fprintf(stdout, "\rPercent Complete:\t\b\b%d%%", *pcomp);
+        }
+        fflush(stdout);
+    }
+    return;
+}
+
+void generateserial(struct GenOptions *opts, FILE *fp){
+    /* This function generates the fractals of a database one at a time */
+    int i;
+    int pcomp = 0;
+    struct Fractal *frac = newcontexts(opts, 1);
+    startoutput(opts);
+    for (i = 0; i < opts -> numtogenerate; i++){
+        buildfrac(frac, opts, opts -> firstfrac + i);
+        commitfrac(fp, frac, opts);
+        printprogress(i, opts -> numtogenerate, &pcomp);
+    }
+    stopoutput(opts);
+    freecontexts(frac, 1);
+    return;
+}
+
+struct GenPool{
+        /* The state shared by the worker threads of generateparallel. 
+         * Fractal i is built in the fractal structure slots[i%numslots],
+         * and ready[i%numslots] is set once it is built, until the 
+         * committer writes it out.
+         */
+        struct GenOptions *opts;
+        struct Fractal *slots;
+        int *ready, numslots, next, committed;
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+};
+
+void * genworker(void *arg){
+    /* This function is run by each worker thread. It repeatedly takes
+     * the next fractal number, builds the fractal and leaves it in
+     * its slot for the committer. Workers never get more than 
+     * numslots fractals ahead of the committer, so the slot of
+     * the fractal taken is always free.
+     */
+    struct GenPool *pool = (struct GenPool *)arg;
+    int i;
+    pthread_mutex_lock(&(pool -> lock));
+    while (1){
+        while (pool -> next < pool -> opts -> numtogenerate && 
+               pool -> next >= pool -> committed + pool -> numslots){
+            pthread_cond_wait(&(pool -> cond), &(pool -> lock));
+        }
+        if (pool -> next >= pool -> opts -> numtogenerate) break;
+        i = pool -> next++;
+        pthread_mutex_unlock(&(pool -> lock));
+
+        buildfrac(&(pool -> slots[i%pool -> numslots]), pool -> opts, pool -> opts -> firstfrac + i);
+
+        pthread_mutex_lock(&(pool -> lock));
+        pool -> ready[i%pool -> numslots] = 1;
+        pthread_cond_broadcast(&(pool -> cond));
+    }
+    pthread_mutex_unlock(&(pool -> lock));
+    return NULL;
+}
+
+void generateparallel(struct GenOptions *opts, FILE *fp){
+    /* This function generates the fractals of a database with
+     * opts -> numthreads worker threads. The calling thread is
+     * the committer: it waits for the fractals in order of their
+     * number and commits them (see commitfrac), so the records are
+     * in the same order as with generateserial.
+     */
+    int i, slot;
+    int pcomp = 0;
+    struct GenPool pool;
+    struct Fractal *frac;
+    pthread_t *threads;
+    pool.opts = opts;
+    pool.numslots = 2 * opts -> numthreads;
+    pool.next = 0;
+    pool.committed = 0;
+    pool.slots = newcontexts(opts, pool.numslots);
+    if (((pool.ready = (int *)calloc(pool.numslots, sizeof(int))) == NULL)||
+        ((threads = (pthread_t *)malloc(opts -> numthreads * sizeof(pthread_t))) == NULL)){
+        fprintf(stderr, "Malloc failed (generateparallel)\n");
+        exit(1);
+    }
+    pthread_mutex_init(&(pool.lock), NULL);
+    pthread_cond_init(&(pool.cond), NULL);
+    startoutput(opts);
+    for (i = 0; i < opts -> numthreads; i++){
+        if (pthread_create(&(threads[i]), NULL, genworker, &pool) != 0){
+            fprintf(stderr, "Failed to create thread (generateparallel)\n");
+            exit(1);
+        }
+    }
+    for (i = 0; i < opts -> numtogenerate; i++){
+        slot = i%pool.numslots;
+        pthread_mutex_lock(&(pool.lock));
+        while (pool.ready[slot] == 0){
+            pthread_cond_wait(&(pool.cond), &(pool.lock));
+        }
+        frac = &(pool.slots[slot]);
+        pthread_mutex_unlock(&(pool.lock));
+
+        commitfrac(fp, frac, opts);
+
+        pthread_mutex_lock(&(pool.lock));
+        pool.ready[slot] = 0;
+        pool.committed++;
+        pthread_cond_broadcast(&(pool.cond));
+        pthread_mutex_unlock(&(pool.lock));
+        printprogress(i, opts -> numtogenerate, &pcomp);
+    }
+    for (i = 0; i < opts -> numthreads; i++){
+        pthread_join(threads[i], NULL);
+    }
+    stopoutput(opts);
+    pthread_mutex_destroy(&(pool.lock));
+    pthread_cond_destroy(&(pool.cond));
+    freecontexts(pool.slots, pool.numslots);
+    free(pool.ready);
+    free(threads);
+    return;
+}
+
+int imagewritten(char *dirname, char *suffix, int kind, int fracnum, struct ShardRange *ranges, int numranges){
+    /* This function returns 1 if the image of fractal fracnum with 
+     * the given suffix ("", "_view0", ..., "_density") is in one of 
+     * the finished shards in ranges or in a png in dirname, else 0
+     */
+    char filename[FILENAMELEN];
+    struct stat st;
+    for (int i = 0; i < numranges; i++){
+        if (ranges[i].kind == kind && fracnum >= ranges[i].first && 
+            fracnum < ranges[i].first + ranges[i].count) return 1;
+    }
+    snprintf(filename, FILENAMELEN, "%sfrac%d%s.png", dirname, fracnum, suffix);
+    return (stat(filename, &st) == 0);
+}
+
+int resumecount(struct GenOptions *opts, int base, int numrows){
+    /* This function returns how many of the numrows fractals already 
+     * in opts -> dirname, numbered from base, have all their images
+     * written. A record is added to the database before its images 
+     * are encoded (see pngqueue.c) or its shard is finished (see 
+     * finishshard), so a run that was stopped leaves records at the 
+     * end without them. Those from the start of a shard that was 
+     * never finished are cut, and so are those from the earliest 
+     * one missing an image among the last fractals, looking back until
+     * RESUMEWINDOW fractals in a row have all theirs. If no images 
+     * are found at all they are taken to be kept elsewhere and 
+     * nothing is cut for them. The images looked for are those of the
+     * current options, so a run should be resumed with the same ones.
+     */
+    char suffixes[MAXVIEWS + 2][16], filename[FILENAMELEN], shardname[FILENAMELEN + 256], rest[32];
+    int numkinds = 1 + opts -> numviews + (opts -> density > 0);
+    int numranges = 0, maxranges = 64, first, kind, missing = -1, run = 0, found = 0;
+    int count = numrows;
+    struct ShardRange *ranges;
+    struct Shard *shard;
+    struct dirent *entry;
+    DIR *dir;
+    if ((ranges = (struct ShardRange *)malloc(maxranges*sizeof(struct ShardRange))) == NULL){
+        fprintf(stderr, "Malloc failed (resumecount)\n");
+        exit(1);
+    }
+    snprintf(suffixes[0], 16, "%s", "");
+    for (kind = 1; kind <= opts -> numviews; kind++) snprintf(suffixes[kind], 16, "_view%d", kind - 1);
+    if (opts -> density > 0) snprintf(suffixes[numkinds - 1], 16, "%s", "_density");
+    if ((dir = opendir(opts -> dirname)) != NULL){
+        while ((entry = readdir(dir)) != NULL){
+            if (sscanf(entry -> d_name, "shard%d%31s", &first, rest) != 2) continue;
+            for (kind = 0; kind < numkinds; kind++){
+                snprintf(filename, FILENAMELEN, "%s.frs", suffixes[kind]);
+                if (strcmp(rest, filename) == 0) break;
+            }
+            if (kind == numkinds || first < base) continue;
+            snprintf(shardname, FILENAMELEN + 256, "%s%s", opts -> dirname, entry -> d_name);
+            if ((shard = openshard(shardname)) == NULL){
+                if (first - base < count) count = first - base;
+                continue;
+            }
+            if (numranges == maxranges){
+                maxranges *= 2;
+                if ((ranges = (struct ShardRange *)realloc(ranges, maxranges*sizeof(struct ShardRange))) == NULL){
+                    fprintf(stderr, "Realloc failed (resumecount)\n");
+                    exit(1);
+                }
+            }
+            ranges[numranges].first = first;
+            ranges[numranges].count = shard -> header -> count;
+            ranges[numranges].kind  = kind;
+            numranges++;
+            closeshard(shard);
+        }
+        closedir(dir);
+    }
+    for (int i = count - 1; i >= 0 && run < RESUMEWINDOW; i--){
+        for (kind = 0; kind < numkinds; kind++){
+            if (!imagewritten(opts -> dirname, suffixes[kind], kind, base + i, ranges, numranges)) break;
+        }
+        if (kind < numkinds){
+            missing = i;
+            run = 0;
+        }
+        else {
+            found = 1;
+            run++;
+        }
+    }
+    if (found && missing >= 0) count = missing;
+    free(ranges);
+    return count;
+}
+
+void truncatetext(char *filepath, int numrows){
+    /* This function cuts fracdata.dat at filepath after its first 
+     * numrows rows, if it has them, which also drops a row left half
+     * written
+     */
+    FILE *fp;
+    int c, rows = 0;
+    long offset = 0;
+    if ((fp = fopen(filepath, "r")) == NULL) return;
+    while (rows < numrows && (c = fgetc(fp)) != EOF){
+        offset++;
+        if (c == '\n') rows++;
+    }
+    fclose(fp);
+    if (rows == numrows && truncate(filepath, offset) != 0){
+        fprintf(stderr, "Failed to truncate file (truncatetext): %s\n", filepath);
+        exit(1);
+    }
+    return;
+}
+
+void generatedb(struct GenOptions *opts){
+    /* This function runs generatedata once the options are set. 
+     * Normally the new fractals are numbered on from the ones already 
+     * in opts -> dirname. With opts -> numshards parts (see genargs.c),
+     * this part's range of numbers is generated into its own directory,
+     * skipping any already there from an earlier, interrupted, attempt.
+     *
+     * The fractals already there are counted from both the database and
+     * fracdata.dat, taking whichever has more. A directory with rows but
+     * no database records has its rows imported first (see importtext).
+     * Fractals at the end whose images were never written, or whose 
+     * rows were never written to a non-empty fracdata.dat, are cut 
+     * from both and generated again (see resumecount).
+     */
+    char filepath[2*FILENAMELEN], partdir[FILENAMELEN];
+    int start, end, numrows, numtext, numwritten;
+    FILE *fp;
+    if (opts -> numshards > 0){
+        snprintf(partdir, FILENAMELEN, "%spart%d/", opts -> dirname, opts -> shard);
+        if (mkdir(partdir, 0777) != 0 && errno != EEXIST){
+            fprintf(stderr, "Failed to make directory (generatedb): %s\n", partdir);
+            exit(1);
+        }
+        opts -> dirname = partdir;
+    }
+    snprintf(filepath, 2*FILENAMELEN, "%sfracdata.dat", opts -> dirname);
+    if (dbcount(opts -> dirname) <= 0 && importtext(opts -> dirname, filepath) > 0){
+        fprintf(stdout, "Added the rows of %s to the database\n", filepath);
+    }
+    if ((numrows = dbcount(opts -> dirname)) < 0) numrows = 0;
+    numtext = 0;
+    if ((fp = fopen(filepath, "r")) != NULL){
+        fclose(fp);
+        if ((numtext = lenfile(filepath)) > numrows) numrows = numtext;
+    }
+    start = 0;
+    if (opts -> numshards > 0){
+        start = opts -> firstfrac + (long long)opts -> numtogenerate*opts -> shard/opts -> numshards;
+    }
+    numwritten = resumecount(opts, start, numrows);
+    if (numtext > 0 && numtext < numwritten) numwritten = numtext;
+    if (numwritten < numrows){
+        fprintf(stdout, "Fractals %d to %d have no images, generating them again\n", 
+                start + numwritten, start + numrows - 1);
+        if (dbcount(opts -> dirname) > numwritten) dbtruncate(opts -> dirname, numwritten);
+        numrows = numwritten;
+    }
+    if (numtext > 0) truncatetext(filepath, numrows);
+    if (opts -> numshards > 0){
+        end   = opts -> firstfrac + (long long)opts -> numtogenerate*(opts -> shard + 1)/opts -> numshards;
+        opts -> firstfrac = start + numrows;
+        opts -> numtogenerate = (end > opts -> firstfrac) ? end - opts -> firstfrac : 0;
+    }
+    else {
+        opts -> firstfrac = numrows;
+    }
+    if ((fp = fopen(filepath, "a")) == NULL){
+        fprintf(stderr, "Error, you must create the directory first\n");
+        exit(1);
+    }
+    if (opts -> writetext == 0){
+        fclose(fp);
+        fp = NULL;
+    }
+    opts -> queuesize = PNGQUEUESIZE * opts -> encodethreads * (1 + opts -> numviews + (opts -> density > 0));
+    fprintf(stdout, "\nUsing seed %llu\n", (unsigned long long)opts -> seed);
+    fprintf(stdout, "Generating fractals %d to %d\n", opts -> firstfrac, opts -> firstfrac + opts -> numtogenerate);
+    if (opts -> numthreads > 1) generateparallel(opts, fp);
+    else generateserial(opts, fp);
+    fprintf(stdout, "\n"); 
+    if (fp != NULL) fclose(fp);
+    return;
+}
+
+void validatekernels(struct GenOptions *opts){
+    /* This function checks the kernels in opts -> kernels (see walkerstep)
+     * against libm. Each fractal of the run is drawn twice from the same
+     * random numbers, once with each, and the pixels lit in one image but
+     * not the other are counted. Nothing is written to opts -> dirname, 
+     * a line is printed for each fractal with its number, the pixels lit
+     * with libm and with the kernels, the pixels that differ, and the 
+     * dimension with libm and with the kernels.
+     */
+    int i, fracnum, diff, libmnumb, worst = -1;
+    long long totaldiff = 0, totalnumb = 0;
+    double worstfrac = 0, dim;
+    size_t j, size = (size_t)opts -> width*opts -> height;
+    unsigned char *libmbm;
+    struct Fractal *frac;
+    frac = newcontexts(opts, 1);
+    if ((libmbm = (unsigned char *)malloc(size*sizeof(unsigned char))) == NULL){
+        fprintf(stderr, "Malloc failed (validatekernels)\n");
+        exit(1);
+    }
+    fprintf(stdout, "\nUsing seed %llu\n", (unsigned long long)opts -> seed);
+    fprintf(stdout, "fracnum\tlibm\tkernels\tdiffer\tlibm dimension\tkernels dimension\n");
+    for (i = 0; i < opts -> numtogenerate; i++){
+        fracnum = opts -> firstfrac + i;
+        frac -> kernels = KERNELLIBM;
+        fillrandfrac(frac, opts -> restrictions, opts -> numrestrictions, opts -> disperse, 
+                     opts -> window, opts -> seed, fracnum);
+        dimension(frac);
+        memcpy(libmbm, frac -> bm, size);
+        libmnumb = frac -> numb;
+        dim = frac -> dimension;
+        frac -> kernels = opts -> kernels;
+        fillrandfrac(frac, opts -> restrictions, opts -> numrestrictions, opts -> disperse, 
+                     opts -> window, opts -> seed, fracnum);
+        dimension(frac);
+        for (diff = 0, j = 0; j < size; j++){
+            diff += ((libmbm[j] == BLANKPIXEL) != (frac -> bm[j] == BLANKPIXEL));
+        }
+        fprintf(stdout, "%d\t%d\t%d\t%d\t%.6f\t%.6f\n", fracnum, libmnumb, frac -> numb, diff, dim, frac -> dimension);
+        totaldiff += diff;
+        totalnumb += frac -> numb;
+        if (frac -> numb > 0 && (double)diff/frac -> numb >= worstfrac){
+            worstfrac = (double)diff/frac -> numb;
+            worst = fracnum;
+        }
+    }
+    fprintf(stdout, "%lld of %lld pixels differ (%.4f%%), the most in fractal %d (%.4f%%)\n", 
+            totaldiff, totalnumb, 100.0*totaldiff/(totalnumb > 0 ? totalnumb : 1), worst, 100*worstfrac);
+    free(libmbm);
+    freecontexts(frac, 1);
+    return;
+}
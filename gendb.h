@@ -0,0 +1,47 @@
+/* FILE NAME: gendb.h */
+struct Fractal;
+struct PNGQueue;
+struct ShardWriter;
+struct FracDBWriter;
+struct GenOptions{
+        double window[4];
+        int firstfrac, numtogenerate, numpoints, numfuncs, numrestrictions, disperse, numthreads, *restrictions;
+        int adaptive, minpoints, pointbatch, usepilot, health, encodethreads, queuesize, coloured, pershard;
+        int writetext, seedgiven, shard, numshards;
+        int width, height, numviews, renderthreads, kernels, validate, probpolicy, sampler;
+        int engine, supersample, fandepth;
+        double minscale, maxscale, mincoverage;
+        int density, densitycounts, tonemap;    //density is 0, or the bits of the density pngs
+        double gamma;
+        struct FracView views[MAXVIEWS];    //only the size and window of each view are used
+        struct PilotOptions pilot;
+        struct PNGSettings png;
+        struct PNGQueue *pngqueue;
+        struct ShardWriter *shards, *viewshards[MAXVIEWS], *densityshards;
+        struct FracDBWriter *db;
+        uint64_t seed;
+        char *dirname;
+};
+
+struct ShardRange{
+        /* The fractals whose images are in a finished shard, see resumecount */
+        int first, count, kind;
+};
+
+void writefracrow(FILE *fp, struct Fractal *frac, int fracnum);
+int readfracrow(FILE *fp, struct Fractal *frac);
+int importtext(char *dirname, char *filepath);
+struct Fractal * newcontexts(struct GenOptions *opts, int num);
+void freecontexts(struct Fractal *fracs, int num);
+void buildfrac(struct Fractal *frac, struct GenOptions *opts, int fracnum);
+void printprogress(int i, int numtogenerate, int *pcomp);
+void startoutput(struct GenOptions *opts);
+void stopoutput(struct GenOptions *opts);
+void commitfrac(FILE *fp, struct Fractal *frac, struct GenOptions *opts);
+void generateserial(struct GenOptions *opts, FILE *fp);
+void generateparallel(struct GenOptions *opts, FILE *fp);
+int imagewritten(char *dirname, char *suffix, int kind, int fracnum, struct ShardRange *ranges, int numranges);
+int resumecount(struct GenOptions *opts, int base, int numrows);
+void truncatetext(char *filepath, int numrows);
+void generatedb(struct GenOptions *opts);
+void validatekernels(struct GenOptions *opts);
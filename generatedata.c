@@ -4,7 +4,9 @@
  * FILE NAME: generatedata.c
  * 
  * This is the main file that, when run,
- * generates databases of fractals
+ * generates databases of fractals. Run without
+ * any options it asks for them one at a time,
+ * otherwise see usage in genargs.c
  */
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,31 +17,70 @@
 #include "vecio.h"
 #include "PNGio.h"
 #include "fracfuncs.h"
+#include "gendb.h"
+#include "fracdb.h"
+#include "genargs.h"
+#include "vecmath.h"
 
-int main(int argc, char *argv[]){
-    int i, j, numpoints, numfuncs, numrows, numtogenerate, numrestrictions, disperse, tmpint;
-    int *restrictions = ivecmem(20);
-    int pcomp = 0; 
+void askoptions(struct GenOptions *opts){
+    /* This function asks for the options of a run, one at a time */
+    int numpoints, minpoints, usepilot, health, engine, numfuncs, numtogenerate, numrestrictions, disperse, probpolicy, sampler, numthreads, renderthreads, kernels, encodethreads, pnglevel, pngstrategy, pngfilters, pngencoding, coloured, density, pershard, writetext, tmpint;
+    long long seed;
+    int *restrictions = opts -> restrictions;
     double window[4];
-    char filename[50], dirname[50], fracname[124],filepath[100],tmp[50];
-    FILE *fp;
-    struct Fractal *frac;
-    srand(time(NULL));
+    char *dirname, filepath[100],tmp[50];
+    if ((dirname = (char *)malloc(FILENAMELEN*sizeof(char))) == NULL){
+        fprintf(stderr, "Malloc failed (askoptions)\n");
+        exit(1);
+    }
     
     fprintf(stdout, "How many fractals would you like to generate: ");
     scanf("%d", &numtogenerate);
     fprintf(stdout, "\n");
-    sprintf(filename, "fracdata.dat");
     fprintf(stdout, "What is the directory called (Note: it should already be created): ");
-    scanf("%s", dirname);
+    scanf("%91s", dirname);
     fprintf(stdout, "\nHow many points would you like to plot for each fractal: ");
     scanf("%d", &numpoints);
+    fprintf(stdout, "\nMinimum number of points to plot, stopping once no new pixels are being\n"
+                    "filled in (or 0 to always plot every point): ");
+    scanf("%d", &minpoints);
+    if (minpoints > 0){
+        char *stopkeys[2] = {"pointbatch", "mincoverage"};
+        char *stopprompts[2] = {
+            "Points between checks for new pixels (eg. 1000000): ",
+            "Stop once a check finds at most this many new pixels per point (eg. 0): "};
+        for (int i = 0; i < 2; i++){
+            fprintf(stdout, "\n%s", stopprompts[i]);
+            scanf("%49s", tmp);
+            if (setoption(opts, stopkeys[i], tmp) != 0){
+                fprintf(stderr, "Error, bad stopping setting: %s\n", tmp);
+                exit(1);
+            }
+        }
+    }
     strcpy(filepath, dirname); 
     fprintf(stdout, "\nHow many functions in each IFS: ");
     scanf("%d", &numfuncs);
     fprintf(stdout, "\nEnter a vector representing the viewing window (eg. minx,maxx,miny,maxy): ");
     scanf("%s", tmp);
     dstrtovec(tmp, window, &tmpint);
+    fprintf(stdout, "\nWhat resolution would you like the images to be (eg. 640, or 640x480): ");
+    scanf("%49s", tmp);
+    if (readres(tmp, &(opts -> width), &(opts -> height)) != 0){
+        fprintf(stderr, "Error, bad resolution: %s\n", tmp);
+        exit(1);
+    }
+    fprintf(stdout, "\nEnter any other resolutions to draw each fractal at from the same points\n"
+                    "(eg. 128,256x256, or 0 for none): ");
+    scanf("%49s", tmp);
+    if (strcmp(tmp, "0") != 0){
+        for (char *res = strtok(tmp, ","); res != NULL; res = strtok(NULL, ",")){
+            if (setoption(opts, "view", res) != 0){
+                fprintf(stderr, "Error, bad resolution or more than %d of them: %s\n", MAXVIEWS, res);
+                exit(1);
+            }
+        }
+    }
     fprintf(stdout, "\n0  - Affine\n"); 
     fprintf(stdout, "1  - x -> acos(bx) + ccos(dy)+e\n");
     fprintf(stdout, "2  - x -> acos(bx) + csin(dy)+e\n");
@@ -60,67 +101,130 @@ int main(int argc, char *argv[]){
     fprintf(stdout, "2 - Ensure there is at least 1 of each transformation type\n");
     fprintf(stdout, "\nWhat dispersion of transformations would you like: ");
     scanf("%d", &disperse);
-    fprintf(stdout, "\n");
-    sprintf(filepath, "%s%s", dirname, filename);
-    if ((fp = fopen(filepath, "r")) == NULL){
-        numrows = 0;
-    }
-    else {
-        numrows = lenfile(filepath);
-    }
-    if ((fp = fopen(filepath, "a")) == NULL){
-        fprintf(stderr, "Error, you must create the directory first\n");
-        exit(1);
-    }
-    fprintf(stdout, "Generating fractals %d to %d\n", numrows, numrows+numtogenerate);
-    for (i = 0; i < numtogenerate; i++){
-        frac = makerandfrac(numpoints, numfuncs, restrictions, numrestrictions, disperse, window);
-        stddev(frac);
-        dimension(frac);
-        int params = 0;
-        /* fractal number, numfuncs, numpoints, numb, avgx, avgy, stddevx, stddevy, dimension, genome */
-        fprintf(fp, "%d\t%d\t%d\t%d\t%d\t%d\t%.15lf\t%.15lf\t%.15lf\t",
-                numrows+i, frac->numfuncs, frac->numpoints, frac->numb, 
-                frac->avgx, frac->avgy, frac->stddevx, frac->stddevy, frac -> dimension);
-        for (j = 0; j < frac -> numfuncs; j++){
-            for (int k = 0; k < multindjump(frac->genome[3][j]); k++){
-                fprintf(fp, "%.15lf\t", frac -> genome[0][params + k]);
-            }
-            params += multindjump(frac->genome[3][j]);
-        }
-        params = 0;
-        for (j = 0; j < frac -> numfuncs; j++){
-            for (int k = 0; k < addindjump(frac->genome[3][j]); k++){
-                fprintf(fp, "%.15lf\t", frac -> genome[1][params + k]);
-            }
-            params += addindjump(frac->genome[3][j]);
-        }
-        for (j = 0; j < frac -> numfuncs; j++){
-            fprintf(fp, "%.15lf\t", frac -> genome[2][j]);
-        }
-        for (j = 0; j < frac -> numfuncs-1; j++){
-            fprintf(fp, "%.15lf\t", frac -> genome[3][j]);
-        }
-        fprintf(fp, "%.15lf\n", frac -> genome[3][frac -> numfuncs -1]);
-        sprintf(fracname, "%sfrac%d.png", dirname, numrows+i);
-        WritePNG(fracname, frac);
-        freefrac(frac);
-        if (numtogenerate >= 100 && (i%((int)(numtogenerate/100.)) == 0)){
-            pcomp += 1;
-            if (pcomp < 10){
-                fprintf(stdout, "\rPercent Complete:\t%d%%", pcomp);
+    fprintf(stdout, "\n0 - Pick each function equally often\n");
+    fprintf(stdout, "1 - Pick functions in proportion to how much they shrink areas, so\n"
+                    "    every pixel gets about the same number of points\n");
+    fprintf(stdout, "\nHow would you like the function probabilities chosen: ");
+    scanf("%d", &probpolicy);
+    fprintf(stdout, "\n0 - Draw the parameters of each function until it is contractive\n");
+    fprintf(stdout, "1 - Draw contractive functions directly, without retries\n");
+    fprintf(stdout, "\nHow would you like the functions drawn: ");
+    scanf("%d", &sampler);
+    fprintf(stdout, "\nWould you like to skip degenerate fractals using a quick low resolution\n"
+                    "pilot render (0 - no, 1 - yes): ");
+    scanf("%d", &usepilot);
+    if (usepilot){
+        char *pilotkeys[8] = {"pilot-points", "pilot-res", "pilot-tries", "pilot-outside", 
+                              "pilot-fill", "pilot-extent", "pilot-offcentre", "pilot-dim"};
+        char *pilotprompts[8] = {
+            "Points in each pilot render (eg. 4000): ",
+            "Resolution of the pilot renders (eg. 64): ",
+            "How many genomes to try for each fractal before giving up (eg. 20): ",
+            "Largest fraction of the pilot points that can be outside the window (eg. 0.02): ",
+            "Smallest and largest fraction of the pilot pixels that can be lit (eg. 0.005,0.6): ",
+            "Smallest width and height of the lit pixels, as a fraction of the window (eg. 0.1): ",
+            "Furthest the centre of the lit pixels can be from the centre of the window,\n"
+            "as a fraction of half the window (eg. 0.6): ",
+            "Smallest and largest estimated dimension (eg. 0.9,1.95): "};
+        for (int i = 0; i < 8; i++){
+            fprintf(stdout, "\n%s", pilotprompts[i]);
+            scanf("%49s", tmp);
+            if (setoption(opts, pilotkeys[i], tmp) != 0){
+                fprintf(stderr, "Error, bad pilot limit: %s\n", tmp);
+                exit(1);
             }
-            else if (pcomp < 100){
-                fprintf(stdout, "\rPercent Complete:\t\b%d%%", pcomp);
-            }
-            else {
-                fprintf(stdout, "\rPercent Complete:\t\b\b%d%%",pcomp);
-            }
-            fflush(stdout);
         }
     }
-    fprintf(stdout, "\n"); 
-    fclose(fp);
+    fprintf(stdout, "\nWould you like to skip fractals whose orbits diverge or don't contract, and\n"
+                    "size the burn-in of the others from how fast they contract (0 - no, 1 - yes): ");
+    scanf("%d", &health);
+    fprintf(stdout, "\n0 - Chaos game, plotting random points\n");
+    fprintf(stdout, "1 - Map every lit pixel through every function until no new pixels are lit\n");
+    fprintf(stdout, "2 - Apply every composition of the functions to points of a short chaos game\n");
+    fprintf(stdout, "\nHow would you like the fractals drawn: ");
+    scanf("%d", &engine);
+    fprintf(stdout, "\nHow many threads would you like to use (1 to generate one fractal at a time): ");
+    scanf("%d", &numthreads);
+    fprintf(stdout, "\nHow many threads would you like to use to plot the points of each fractal\n"
+                    "(1 for one thread, more is only worth it with millions of points): ");
+    scanf("%d", &renderthreads);
+    fprintf(stdout, "\n0 - libm\n");
+    fprintf(stdout, "1 - Vectorized, as accurate as libm\n");
+    fprintf(stdout, "2 - Vectorized fast approximations (error below %g)\n", FASTMATHERROR);
+    fprintf(stdout, "\nHow would you like cos, sin and tanh to be computed: ");
+    scanf("%d", &kernels);
+    fprintf(stdout, "\nHow many threads would you like to use to write pngs (0 to write them on\n"
+                    "the threads generating fractals): ");
+    scanf("%d", &encodethreads);
+    fprintf(stdout, "\nWhat png compression level would you like (0-9, lower is faster, -1 for the default): ");
+    scanf("%d", &pnglevel);
+    fprintf(stdout, "\n0 - Default, 1 - Filtered, 2 - Huffman only, 3 - RLE, 4 - Fixed\n");
+    fprintf(stdout, "\nWhich zlib strategy would you like (-1 to leave it to libpng): ");
+    scanf("%d", &pngstrategy);
+    fprintf(stdout, "\n8 - None, 16 - Sub, 32 - Up, 64 - Average, 128 - Paeth\n");
+    fprintf(stdout, "\nWhich png row filters would you like tried, added together (-1 to leave\n"
+                    "it to libpng): ");
+    scanf("%d", &pngfilters);
+    fprintf(stdout, "\n0 - 24 bit colour pngs\n");
+    fprintf(stdout, "1 - Compact pngs (1 bit black and white, or 8 bit palette when coloured)\n");
+    fprintf(stdout, "\nWhich png encoding would you like: ");
+    scanf("%d", &pngencoding);
+    fprintf(stdout, "\nWould you like to colour the fractals by which function made each point\n"
+                    "(0 - yes, 1 - no, black): ");
+    scanf("%d", &coloured);
+    fprintf(stdout, "\nWould you like a density png of each fractal as well, counting the points\n"
+                    "on each pixel (0 - no, 8 or 16 - bits per pixel): ");
+    scanf("%d", &density);
+    if (density != 0 && density != 8 && density != 16){
+        fprintf(stderr, "Error, density pngs must be 8 or 16 bits\n");
+        exit(1);
+    }
+    fprintf(stdout, "\nHow many fractals would you like in each shard file (0 to write a png\n"
+                    "for each fractal): ");
+    scanf("%d", &pershard);
+    fprintf(stdout, "\nWould you like fracdata.dat written as text as well as the binary database\n"
+                    "(0 - no, 1 - yes): ");
+    scanf("%d", &writetext);
+    fprintf(stdout, "\nEnter a seed for the random number generator (-1 to use the time): ");
+    scanf("%lld", &seed);
+    if (seed < 0) seed = time(NULL);
+    opts -> numtogenerate   = numtogenerate;
+    opts -> numpoints       = numpoints;
+    opts -> minpoints       = minpoints;
+    opts -> usepilot        = usepilot;
+    opts -> health          = health;
+    opts -> engine          = engine;
+    opts -> numfuncs        = numfuncs;
+    opts -> numrestrictions = numrestrictions;
+    opts -> disperse        = disperse;
+    opts -> probpolicy      = probpolicy;
+    opts -> sampler         = sampler;
+    opts -> numthreads      = numthreads;
+    opts -> renderthreads   = renderthreads;
+    opts -> kernels         = kernels;
+    opts -> encodethreads   = encodethreads;
+    opts -> png.level       = pnglevel;
+    opts -> png.strategy    = pngstrategy;
+    opts -> png.filters     = pngfilters;
+    opts -> png.encoding    = pngencoding;
+    opts -> coloured        = coloured;
+    opts -> density         = density;
+    opts -> pershard        = pershard;
+    opts -> writetext       = writetext;
+    opts -> seed            = seed;
+    opts -> dirname         = dirname;
+    for (int i = 0; i < 4; i++) opts -> window[i] = window[i];
+    return;
+}
+
+int main(int argc, char *argv[]){
+    struct GenOptions opts;
+    defaultoptions(&opts);
+    if (argc > 1) readargs(argc, argv, &opts);
+    else askoptions(&opts);
+    checkoptions(&opts);
+    if (opts.validate) validatekernels(&opts);
+    else generatedb(&opts);
     exit(0);
 }
 
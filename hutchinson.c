@@ -0,0 +1,253 @@
+/* FILE NAME: hutchinson.c
+ *
+ * This file contains the set engine, which draws a fractal by 
+ * iterating the Hutchinson operator H(S) = f1(S) u f2(S) u ... u fn(S)
+ * on the set of lit pixels, instead of playing the chaos game (see
+ * generatepoints). The attractor is the fixed point of H, so once 
+ * a point on it is lit, mapping it through every function lights 
+ * more of it, until no new pixels are lit.
+ *
+ * Each pixel is split into supersample x supersample cells, and the
+ * set is kept as a bitset of lit cells. Every cell remembers the point
+ * that lit it only until it has been mapped: only the points that lit
+ * new cells in the last iteration (the frontier) are mapped in the 
+ * next, through every function, since every older cell has been mapped
+ * already. The work is therefore bounded by the number of cells, and 
+ * the image doesn't depend on how lucky the random orbit was. 
+ *
+ * The points mapped are the exact points that lit each cell, not the 
+ * centres of the cells, since rounding every point to the centre of 
+ * its cell would light pixels around the attractor as well, the errors
+ * adding up from one iteration to the next. A cell only keeps the first
+ * point that lands on it, so parts of the attractor that are only the
+ * image of other points of a lit cell can be missed, most of all on 
+ * the border of a piecewise function (functype 10). To fill them in,
+ * once no new cells are lit the chaos game orbit of the seeds is played
+ * on in batches of SETBATCH points, every cell it lights being mapped
+ * as before, until a batch lights no new pixels or numpoints points 
+ * have been played. Its points are on the attractor, so nothing around
+ * it is lit.
+ *
+ * The functions are the same compiled maps used by the chaos game (see
+ * mapfunc), including the trig and piecewise ones. Points mapped outside
+ * of the window are dropped rather than drawn on its border, since they
+ * aren't kept to be mapped again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "Fractals.h"
+#include "hutchinson.h"
+
+struct FracSet * newfracset(int width, int height, int supersample){
+    /* This function allocates a set for a width x height image with 
+     * each pixel split into supersample x supersample cells
+     */
+    struct FracSet *set;
+    if ((set = (struct FracSet *)malloc(sizeof(struct FracSet))) == NULL){
+        fprintf(stderr, "Malloc failed (newfracset)\n");
+        exit(1);
+    }
+    set -> lit = NULL;
+    set -> xs = set -> ys = set -> nextxs = set -> nextys = NULL;
+    set -> width = set -> height = set -> supersample = 0;
+    set -> cap = 0;
+    resizefracset(set, width, height, supersample);
+    return set;
+}
+
+void resizefracset(struct FracSet *set, int width, int height, int supersample){
+    /* This function (re)allocates the bitset of a set for a width x height
+     * image with each pixel split into supersample x supersample cells.
+     * The frontiers grow as they need to (see lightcell).
+     */
+    if (set -> width == width && set -> height == height && set -> supersample == supersample) return;
+    if ((long long)width*supersample > INT_MAX || (long long)height*supersample > INT_MAX){
+        fprintf(stderr, "Too many cells for a %dx%d image (resizefracset)\n", width, height);
+        exit(1);
+    }
+    free(set -> lit);
+    set -> width  = width;
+    set -> height = height;
+    set -> supersample = supersample;
+    set -> cellwidth  = width*supersample;
+    set -> cellheight = height*supersample;
+    set -> words = ((size_t)set -> cellwidth*set -> cellheight + 63)/64;
+    if ((set -> lit = (uint64_t *)malloc(set -> words*sizeof(uint64_t))) == NULL){
+        fprintf(stderr, "Malloc failed (resizefracset)\n");
+        exit(1);
+    }
+    return;
+}
+
+void freefracset(struct FracSet *set){
+    /* This function frees a set made by newfracset */
+    if (set == NULL) return;
+    free(set -> lit);
+    free(set -> xs);
+    free(set -> ys);
+    free(set -> nextxs);
+    free(set -> nextys);
+    free(set);
+    return;
+}
+
+double mapstretch(struct FracMap *map){
+    /* This function returns a bound on how much a compiled function 
+     * can stretch distances, the Frobenius norm of its Jacobian. For 
+     * the trig maps each entry of the Jacobian, a*b*f'(b*x), is at 
+     * most |a*b|.
+     */
+    double *m = map -> m, s = 0, s2 = 0;
+    int i;
+    if (map -> type == 0 || map -> type == 10){
+        for (i = 0; i < 4; i++) s += m[i]*m[i];
+        if (map -> type == 10){
+            for (i = 4; i < 8; i++) s2 += m[i]*m[i];
+            if (s2 > s) s = s2;
+        }
+        return sqrt(s);
+    }
+    for (i = 0; i < 4; i++) s += m[2*i]*m[2*i]*m[2*i+1]*m[2*i+1];
+    return sqrt(s);
+}
+
+int setsupersample(struct Fractal *frac){
+    /* This function picks how many cells across each pixel the set 
+     * engine uses. A function that stretches a cell over several 
+     * pixels only maps one point of it, so the cells are made smaller
+     * by how much the functions stretch: twice the largest stretch,
+     * between 2 and MAXSUPERSAMPLE.
+     */
+    double stretch = 1, s;
+    for (int i = 0; i < frac -> numfuncs; i++){
+        if ((s = mapstretch(&(frac -> maps[i]))) > stretch) stretch = s;
+    }
+    if (2*stretch > MAXSUPERSAMPLE) return MAXSUPERSAMPLE;
+    return (int)ceil(2*stretch);
+}
+
+int lightcell(struct Fractal *frac, double x, double y, int funcnum, double *max){
+    /* This function lights the cell that (x, y) falls on, if it is in
+     * the window and wasn't lit yet, plotting the point and adding it
+     * to the next frontier. It returns 1 if the cell is new.
+     */
+    struct FracSet *set = frac -> set;
+    double *window = frac -> window;
+    double cx = set -> cellwidth *(x - window[0])/(window[1] - window[0]);
+    double cy = set -> cellheight*(window[3] - y)/(window[3] - window[2]);
+    size_t i;
+    if (!(cx >= 0 && cx < set -> cellwidth && cy >= 0 && cy < set -> cellheight)) return 0;
+    i = (size_t)cy*set -> cellwidth + (size_t)cx;
+    if (set -> lit[i/64] & ((uint64_t)1 << (i%64))) return 0;
+    set -> lit[i/64] |= (uint64_t)1 << (i%64);
+    if ((size_t)set -> numnext >= set -> cap){
+        set -> cap = (set -> cap > 0) ? 2*set -> cap : 4096;
+        if (((set -> xs     = (double *)realloc(set -> xs,     set -> cap*sizeof(double))) == NULL)||
+            ((set -> ys     = (double *)realloc(set -> ys,     set -> cap*sizeof(double))) == NULL)||
+            ((set -> nextxs = (double *)realloc(set -> nextxs, set -> cap*sizeof(double))) == NULL)||
+            ((set -> nextys = (double *)realloc(set -> nextys, set -> cap*sizeof(double))) == NULL)){
+            fprintf(stderr, "Malloc failed (lightcell)\n");
+            exit(1);
+        }
+    }
+    set -> nextxs[set -> numnext] = x;
+    set -> nextys[set -> numnext] = y;
+    set -> numnext++;
+    plotpoint(frac, x, y, funcnum);
+    for (int v = 0; v < frac -> numviews; v++) plotview(&(frac -> views[v]), x, y, funcnum);
+    if (fabs(x) > *max) *max = fabs(x);
+    if (fabs(y) > *max) *max = fabs(y);
+    return 1;
+}
+
+long long iterateset(struct Fractal *frac, double *max){
+    /* This function maps the frontier of a set through every function,
+     * then the cells that lit, and so on until no new cells are lit. It
+     * returns the number of points mapped.
+     */
+    struct FracSet *set = frac -> set;
+    long long mapped = 0;
+    double x, y, *tmp;
+    while (set -> numnext > 0){
+        tmp = set -> xs; set -> xs = set -> nextxs; set -> nextxs = tmp;
+        tmp = set -> ys; set -> ys = set -> nextys; set -> nextys = tmp;
+        set -> numfrontier = set -> numnext;
+        set -> numnext = 0;
+        for (int i = 0; i < set -> numfrontier; i++){
+            for (int f = 0; f < frac -> numfuncs; f++){
+                x = set -> xs[i];
+                y = set -> ys[i];
+                mapfunc(&x, &y, &(frac -> maps[f]));
+                lightcell(frac, x, y, f, max);
+            }
+        }
+        mapped += (long long)set -> numfrontier*frac -> numfuncs;
+    }
+    return mapped;
+}
+
+double generateset(struct Fractal *frac){
+    /* This function draws a fractal with the set engine (see the top
+     * of this file) instead of generatepoints. The set is seeded with
+     * SETSEEDS points of a chaos game orbit, after its burn-in, so the
+     * seeds are already on the attractor. Each iteration then maps the 
+     * frontier through every function until no new cells are lit.
+     *
+     * Each pixel is split into frac -> supersample cells across, or as
+     * many as setsupersample picks if it is 0. Once no new cells are
+     * lit, up to frac -> numpoints more points of the chaos game are 
+     * played (see the top of this file). The number of points mapped,
+     * those included, is stored in frac -> pointsused, and adaptive and
+     * keeppoints aren't used. Pixels are coloured by the function
+     * that last lit one of their cells, and a density histogram counts 
+     * the cells lit in each pixel. It returns the largest coordinate of
+     * any lit point, like generatepoints.
+     */
+    int i, f, numb, played, numfuncs = frac -> numfuncs;
+    int s = (frac -> supersample > 0) ? frac -> supersample : setsupersample(frac);
+    long long mapped = 0;
+    double x, y, max = 0;
+    struct FracRNG *rng = &(frac -> rng);
+    struct FracSet *set;
+    if (frac -> set == NULL) frac -> set = newfracset(frac -> width, frac -> height, s);
+    set = frac -> set;
+    resizefracset(set, frac -> width, frac -> height, s);
+    memset(set -> lit, 0, set -> words*sizeof(uint64_t));
+    set -> numnext = 0;
+
+    /* seeds */
+    x = rnguniform(rng);
+    y = rnguniform(rng);
+    for (i = 0; i < frac -> burnin; i++){
+        mapfunc(&x, &y, &(frac -> maps[rngint(rng, numfuncs)]));
+    }
+    for (i = 0; i < SETSEEDS; i++){
+        f = pickfunc(frac, rnguniform(rng));
+        mapfunc(&x, &y, &(frac -> maps[f]));
+        lightcell(frac, x, y, f, &max);
+    }
+    mapped = SETSEEDS;
+
+    /* iterate H on the frontier until it is empty, then keep playing
+     * the chaos game from the seeds while it still lights new pixels,
+     * iterating H on every cell it lights
+     */
+    mapped += iterateset(frac, &max);
+    for (played = 0; played < frac -> numpoints; ){
+        numb = frac -> stats.numb;
+        for (i = 0; i < SETBATCH && played < frac -> numpoints; i++, played++){
+            f = pickfunc(frac, rnguniform(rng));
+            mapfunc(&x, &y, &(frac -> maps[f]));
+            lightcell(frac, x, y, f, &max);
+        }
+        mapped += i + iterateset(frac, &max);
+        if (frac -> stats.numb == numb) break;
+    }
+    frac -> pointsused = (mapped < INT32_MAX) ? (int)mapped : INT32_MAX;
+    return max;
+}
@@ -0,0 +1,27 @@
+/* FILE NAME: hutchinson.h */
+#include <stdint.h>
+
+struct Fractal;
+struct FracMap;
+struct FracSet{
+        /* Scratch space for drawing a fractal with the set engine (see
+         * generateset). Each pixel of a width x height image is split into
+         * supersample x supersample cells, and cell row*cellwidth + col 
+         * is lit if bit i%64 of lit[i/64] is set. xs, ys hold the numfrontier
+         * points that lit cells in the last iteration and nextxs, nextys
+         * the numnext that lit cells in this one, with room for cap each.
+         */
+        int width, height, supersample, cellwidth, cellheight, numfrontier, numnext;
+        size_t words, cap;
+        uint64_t *lit;
+        double *xs, *ys, *nextxs, *nextys;
+};
+
+struct FracSet * newfracset(int width, int height, int supersample);
+void resizefracset(struct FracSet *set, int width, int height, int supersample);
+void freefracset(struct FracSet *set);
+double mapstretch(struct FracMap *map);
+int setsupersample(struct Fractal *frac);
+int lightcell(struct Fractal *frac, double x, double y, int funcnum, double *max);
+long long iterateset(struct Fractal *frac, double *max);
+double generateset(struct Fractal *frac);
@@ -0,0 +1,138 @@
+/* FILE NAME: mergedb.c
+ *
+ * This file merges the parts of a sharded run of generatedata
+ * (see genargs.c) into one database. The records of each part
+ * are appended to the database in the output directory in order
+ * of fractal number, as are the rows of their fracdata.dat, and
+ * their pngs and shard files are moved into the output directory.
+ * The parts have to cover disjoint ranges of fractal numbers, 
+ * which all come after any fractals already in the output.
+ *
+ * usage: ./mergedb output/ part0/ part1/ ...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <dirent.h>
+#include "Fractals.h"
+#include "fracdb.h"
+
+struct Part{
+        char *dirname;
+        struct FracDB *db;
+        int first, last;
+};
+
+int comparefirst(const void *a, const void *b){
+    /* This function orders parts by their first fractal number */
+    return ((struct Part *)a) -> first - ((struct Part *)b) -> first;
+}
+
+void appendtext(char *outdir, char *dirname){
+    /* This function appends fracdata.dat of a part to the output's */
+    char filepath[FILENAMELEN], buffer[65536];
+    size_t len;
+    FILE *in, *out;
+    snprintf(filepath, FILENAMELEN, "%sfracdata.dat", dirname);
+    if ((in = fopen(filepath, "r")) == NULL) return;
+    snprintf(filepath, FILENAMELEN, "%sfracdata.dat", outdir);
+    if ((out = fopen(filepath, "a")) == NULL){
+        fprintf(stderr, "Failed to open file (appendtext): %s\n", filepath);
+        exit(1);
+    }
+    while ((len = fread(buffer, 1, 65536, in)) > 0){
+        fwrite(buffer, 1, len, out);
+    }
+    fclose(in);
+    fclose(out);
+    return;
+}
+
+int moveimages(char *outdir, char *dirname){
+    /* This function moves the pngs and shard files of a part into 
+     * the output directory and returns how many were moved
+     */
+    char from[2*FILENAMELEN + 256], to[2*FILENAMELEN + 256];
+    int nummoved = 0, len;
+    struct dirent *entry;
+    DIR *dir = opendir(dirname);
+    if (dir == NULL) return 0;
+    while ((entry = readdir(dir)) != NULL){
+        len = strlen(entry -> d_name);
+        if (!((strncmp(entry -> d_name, "frac", 4) == 0 && len > 4 && strcmp(&(entry -> d_name[len-4]), ".png") == 0) ||
+              (strncmp(entry -> d_name, "shard", 5) == 0 && len > 4 && strcmp(&(entry -> d_name[len-4]), ".frs") == 0))){
+            continue;
+        }
+        snprintf(from, 2*FILENAMELEN + 256, "%s%s", dirname, entry -> d_name);
+        snprintf(to, 2*FILENAMELEN + 256, "%s%s", outdir, entry -> d_name);
+        if (rename(from, to) != 0){
+            fprintf(stderr, "Failed to move %s to %s\n", from, to);
+            exit(1);
+        }
+        nummoved++;
+    }
+    closedir(dir);
+    return nummoved;
+}
+
+int main(int argc, char *argv[]){
+    int i, numparts = 0, nummoved = 0, lastid = -1;
+    long long j, numrecords = 0;
+    struct Part *parts;
+    struct FracDB *out;
+    struct FracDBWriter *writer;
+
+    if (argc < 3){
+        fprintf(stderr, "usage: %s output/ part0/ part1/ ...\n", argv[0]);
+        exit(1);
+    }
+    if ((parts = (struct Part *)malloc((argc - 2)*sizeof(struct Part))) == NULL){
+        fprintf(stderr, "Malloc failed (mergedb)\n");
+        exit(1);
+    }
+    for (i = 2; i < argc; i++){
+        struct FracDB *db = opendb(argv[i]);
+        if (db == NULL){
+            fprintf(stderr, "Error, there is no database in %s\n", argv[i]);
+            exit(1);
+        }
+        if (db -> count == 0){
+            closedb(db);
+            continue;
+        }
+        parts[numparts].dirname = argv[i];
+        parts[numparts].db = db;
+        parts[numparts].first = ((int32_t *)db -> cols[DBID])[0];
+        parts[numparts].last = ((int32_t *)db -> cols[DBID])[db -> count - 1];
+        numparts++;
+    }
+    qsort(parts, numparts, sizeof(struct Part), comparefirst);
+    if ((out = opendb(argv[1])) != NULL){
+        if (out -> count > 0) lastid = ((int32_t *)out -> cols[DBID])[out -> count - 1];
+        closedb(out);
+    }
+    for (i = 0; i < numparts; i++){
+        if (parts[i].first <= lastid){
+            fprintf(stderr, "Error, fractals %d to %d in %s overlap ones already merged\n", 
+                    parts[i].first, parts[i].last, parts[i].dirname);
+            exit(1);
+        }
+        lastid = parts[i].last;
+    }
+    writer = newdbwriter(argv[1]);
+    for (i = 0; i < numparts; i++){
+        for (j = 0; j < parts[i].db -> count; j++){
+            dbcopyrecord(writer, parts[i].db, j);
+        }
+        numrecords += parts[i].db -> count;
+        appendtext(argv[1], parts[i].dirname);
+        nummoved += moveimages(argv[1], parts[i].dirname);
+        closedb(parts[i].db);
+    }
+    closedbwriter(writer);
+    free(parts);
+    fprintf(stdout, "Merged %lld fractals from %d parts, moved %d images\n", numrecords, numparts, nummoved);
+    exit(0);
+}
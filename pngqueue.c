@@ -0,0 +1,219 @@
+/* FILE NAME: pngqueue.c
+ *
+ * This file contains a pool of threads that write pngs
+ * so that generating fractals doesn't have to wait for
+ * their pngs to be compressed and written. Generating
+ * threads copy a finished pixel map into the queue with
+ * pushpng and move on. If the queue is full, pushpng waits
+ * until the encoders have caught up, so pngs can't pile 
+ * up in memory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "Fractals.h"
+#include "PNGio.h"
+#include "pngqueue.h"
+
+void * pngworker(void *arg){
+    /* This function is run by each encoder thread. It writes the
+     * oldest waiting png until the queue is closed and empty.
+     */
+    struct PNGQueue *queue = (struct PNGQueue *)arg;
+    int slot;
+    unsigned char *pixels;
+    pthread_mutex_lock(&(queue -> lock));
+    while (1){
+        while (queue -> numwaiting == 0 && queue -> closing == 0){
+            pthread_cond_wait(&(queue -> waiting), &(queue -> lock));
+        }
+        if (queue -> numwaiting == 0) break;
+        slot = queue -> order[queue -> head];
+        queue -> head = (queue -> head + 1)%queue -> size;
+        queue -> numwaiting--;
+        queue -> state[slot] = 2;
+        pthread_mutex_unlock(&(queue -> lock));
+
+        pixels = &(queue -> pixels[slot*queue -> imagesize]);
+        if (queue -> graybits[slot] > 0){
+            WritePNGgray(queue -> filenames[slot], pixels, queue -> widths[slot], queue -> heights[slot], 
+                         queue -> graybits[slot], queue -> settings);
+        }
+        else if (queue -> packed && queue -> coloured[slot] == 1){
+            WritePNGbits(queue -> filenames[slot], pixels, queue -> widths[slot], queue -> heights[slot], 
+                         queue -> settings);
+        }
+        else {
+            WritePNGpixels(queue -> filenames[slot], pixels, queue -> widths[slot], queue -> heights[slot], 
+                           queue -> coloured[slot], queue -> numfuncs[slot], queue -> settings);
+        }
+
+        pthread_mutex_lock(&(queue -> lock));
+        queue -> state[slot] = 0;
+        pthread_cond_signal(&(queue -> freed));
+    }
+    pthread_mutex_unlock(&(queue -> lock));
+    return NULL;
+}
+
+struct PNGQueue * newpngqueue(int numthreads, int size, size_t imagesize, struct PNGSettings *settings){
+    /* This function starts numthreads encoder threads with room for 
+     * size pngs of at most imagesize bytes in the queue. All the memory
+     * for the queue is allocated here. settings can be NULL for libpng's
+     * defaults.
+     */
+    int i;
+    struct PNGQueue *queue;
+    if (((queue = (struct PNGQueue *)malloc(sizeof(struct PNGQueue))) == NULL)||
+        ((queue -> filenames = (char **)malloc(size * sizeof(char *))) == NULL)||
+        ((queue -> pixels = (unsigned char *)malloc(size*imagesize)) == NULL)||
+        ((queue -> widths = (int *)malloc(size * sizeof(int))) == NULL)||
+        ((queue -> heights = (int *)malloc(size * sizeof(int))) == NULL)||
+        ((queue -> graybits = (int *)malloc(size * sizeof(int))) == NULL)||
+        ((queue -> coloured = (int *)malloc(size * sizeof(int))) == NULL)||
+        ((queue -> numfuncs = (int *)malloc(size * sizeof(int))) == NULL)||
+        ((queue -> state = (int *)calloc(size, sizeof(int))) == NULL)||
+        ((queue -> order = (int *)malloc(size * sizeof(int))) == NULL)||
+        ((queue -> threads = (pthread_t *)malloc(numthreads * sizeof(pthread_t))) == NULL)){
+        fprintf(stderr, "Malloc failed (newpngqueue)\n");
+        exit(1);
+    }
+    for (i = 0; i < size; i++){
+        if ((queue -> filenames[i] = (char *)malloc(FILENAMELEN * sizeof(char))) == NULL){
+            fprintf(stderr, "Malloc failed (newpngqueue)\n");
+            exit(1);
+        }
+    }
+    queue -> size = size;
+    queue -> imagesize = imagesize;
+    queue -> head = 0;
+    queue -> numwaiting = 0;
+    queue -> numthreads = numthreads;
+    queue -> closing = 0;
+    queue -> settings = settings;
+    queue -> packed = (settings == NULL || settings -> encoding == PNGCOMPACT);
+    pthread_mutex_init(&(queue -> lock), NULL);
+    pthread_cond_init(&(queue -> waiting), NULL);
+    pthread_cond_init(&(queue -> freed), NULL);
+    for (i = 0; i < numthreads; i++){
+        if (pthread_create(&(queue -> threads[i]), NULL, pngworker, queue) != 0){
+            fprintf(stderr, "Failed to create thread (newpngqueue)\n");
+            exit(1);
+        }
+    }
+    return queue;
+}
+
+int takeslot(struct PNGQueue *queue){
+    /* This function marks a free slot of the queue as taken and 
+     * returns it, waiting for one to be freed if there are none
+     */
+    int slot;
+    pthread_mutex_lock(&(queue -> lock));
+    while (1){
+        for (slot = 0; slot < queue -> size; slot++){
+            if (queue -> state[slot] == 0) break;
+        }
+        if (slot < queue -> size) break;
+        pthread_cond_wait(&(queue -> freed), &(queue -> lock));
+    }
+    queue -> state[slot] = 1;
+    pthread_mutex_unlock(&(queue -> lock));
+    return slot;
+}
+
+void waitslot(struct PNGQueue *queue, int slot){
+    /* This function adds a filled in slot to the end of the 
+     * waiting pngs and wakes up an encoder thread
+     */
+    pthread_mutex_lock(&(queue -> lock));
+    queue -> order[(queue -> head + queue -> numwaiting)%queue -> size] = slot;
+    queue -> numwaiting++;
+    pthread_cond_signal(&(queue -> waiting));
+    pthread_mutex_unlock(&(queue -> lock));
+    return;
+}
+
+void pushpng(struct PNGQueue *queue, char *filename, unsigned char *bm, int width, int height, 
+             int coloured, int numfuncs){
+    /* This function copies a width x height pixel map of a fractal 
+     * (see WritePNGpixels), or its packed bitmap for compact black pngs,
+     * into a free slot of the queue to be written to filename. It waits 
+     * for a slot to be freed if there are none. Once it returns, the 
+     * pixel map can be reused.
+     */
+    int slot;
+    if ((size_t)width*height > queue -> imagesize){
+        fprintf(stderr, "Image too large for the png queue (%dx%d)\n", width, height);
+        exit(1);
+    }
+    slot = takeslot(queue);
+    snprintf(queue -> filenames[slot], FILENAMELEN, "%s", filename);
+    if (queue -> packed && coloured == 1){
+        packbitmap(bm, width, height, &(queue -> pixels[slot*queue -> imagesize]));
+    }
+    else {
+        memcpy(&(queue -> pixels[slot*queue -> imagesize]), bm, (size_t)width*height);
+    }
+    queue -> widths[slot]   = width;
+    queue -> heights[slot]  = height;
+    queue -> coloured[slot] = coloured;
+    queue -> numfuncs[slot] = numfuncs;
+    queue -> graybits[slot] = 0;
+    waitslot(queue, slot);
+    return;
+}
+
+void pushgray(struct PNGQueue *queue, char *filename, unsigned char *gray, int width, int height, int bits){
+    /* This function copies a width x height greyscale image of bits 
+     * (8 or 16) bits per pixel into the queue, like pushpng
+     */
+    int slot;
+    size_t size = (size_t)width*height*(bits/8);
+    if (size > queue -> imagesize){
+        fprintf(stderr, "Image too large for the png queue (%dx%d)\n", width, height);
+        exit(1);
+    }
+    slot = takeslot(queue);
+    snprintf(queue -> filenames[slot], FILENAMELEN, "%s", filename);
+    memcpy(&(queue -> pixels[slot*queue -> imagesize]), gray, size);
+    queue -> widths[slot]   = width;
+    queue -> heights[slot]  = height;
+    queue -> graybits[slot] = bits;
+    waitslot(queue, slot);
+    return;
+}
+
+void closepngqueue(struct PNGQueue *queue){
+    /* This function waits for every png in the queue to be 
+     * written, then stops the encoder threads and frees the queue
+     */
+    int i;
+    pthread_mutex_lock(&(queue -> lock));
+    queue -> closing = 1;
+    pthread_cond_broadcast(&(queue -> waiting));
+    pthread_mutex_unlock(&(queue -> lock));
+    for (i = 0; i < queue -> numthreads; i++){
+        pthread_join(queue -> threads[i], NULL);
+    }
+    pthread_mutex_destroy(&(queue -> lock));
+    pthread_cond_destroy(&(queue -> waiting));
+    pthread_cond_destroy(&(queue -> freed));
+    for (i = 0; i < queue -> size; i++){
+        free(queue -> filenames[i]);
+    }
+    free(queue -> filenames);
+    free(queue -> pixels);
+    free(queue -> coloured);
+    free(queue -> numfuncs);
+    free(queue -> widths);
+    free(queue -> heights);
+    free(queue -> graybits);
+    free(queue -> state);
+    free(queue -> order);
+    free(queue -> threads);
+    free(queue);
+    return;
+}
@@ -0,0 +1,32 @@
+/* FILE NAME: pngqueue.h */
+#include <pthread.h>
+
+struct PNGSettings;
+struct PNGQueue{
+        /* A bounded queue of pngs waiting to be written by a pool of 
+         * encoder threads. Slot i holds one image: its filename, a copy
+         * of the pixel map (of at most imagesize pixels), its size and 
+         * state[i] which is 0 if the slot is free, 1 if it is waiting 
+         * and 2 if it is being written. order is the ring of waiting 
+         * slots, oldest first. If packed is 1, black 
+         * fractals are stored as packed bitmaps (see packbitmap).
+         * graybits[i] is 8 or 16 if slot i holds a greyscale image
+         * of that many bits per pixel (see pushgray), and 0 otherwise.
+         */
+        char **filenames;
+        unsigned char *pixels;
+        int *coloured, *numfuncs, *widths, *heights, *graybits, packed, *state, *order, size, head, numwaiting, numthreads, closing;
+        size_t imagesize;
+        struct PNGSettings *settings;
+        pthread_t *threads;
+        pthread_mutex_t lock;
+        pthread_cond_t waiting, freed;
+};
+
+struct PNGQueue * newpngqueue(int numthreads, int size, size_t imagesize, struct PNGSettings *settings);
+int takeslot(struct PNGQueue *queue);
+void waitslot(struct PNGQueue *queue, int slot);
+void pushpng(struct PNGQueue *queue, char *filename, unsigned char *bm, int width, int height, 
+             int coloured, int numfuncs);
+void pushgray(struct PNGQueue *queue, char *filename, unsigned char *gray, int width, int height, int bits);
+void closepngqueue(struct PNGQueue *queue);
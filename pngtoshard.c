@@ -0,0 +1,73 @@
+/* FILE NAME: pngtoshard.c
+ *
+ * This file converts a database written by generatedata 
+ * with a png for every fractal into shard files (see shard.c).
+ * The rows of fracdata.dat give the stats and genomes, and
+ * the shards are written to the same directory as the pngs,
+ * which are left in place.
+ *
+ * usage: ./pngtoshard directory/ fractals_per_shard coloured
+ * where coloured is 0 for pngs coloured by function and 1 for 
+ * black pngs, as in generatedata. The shards take the resolution
+ * of the first png, and every png must be the same size.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "Fractals.h"
+#include "fracfuncs.h"
+#include "PNGio.h"
+#include "shard.h"
+#include "gendb.h"
+
+int main(int argc, char *argv[]){
+    int pershard, coloured, ret, width, height, numdone = 0, row = 0;
+    char filepath[FILENAMELEN];
+    FILE *fp;
+    struct Fractal frac;
+    struct ShardWriter *writer = NULL;
+
+    if (argc != 4){
+        fprintf(stderr, "usage: %s directory/ fractals_per_shard coloured\n", argv[0]);
+        exit(1);
+    }
+    pershard = atoi(argv[2]);
+    coloured = atoi(argv[3]);
+    if (pershard < 1){
+        fprintf(stderr, "Error, there must be at least 1 fractal per shard\n");
+        exit(1);
+    }
+    snprintf(filepath, FILENAMELEN, "%sfracdata.dat", argv[1]);
+    if ((fp = fopen(filepath, "r")) == NULL){
+        fprintf(stderr, "Failed to open file (pngtoshard): %s\n", filepath);
+        exit(1);
+    }
+    initializefrac(&frac, 1, 1);
+    for (row = 0; (ret = readfracrow(fp, &frac)) >= 0; row++){
+        if (ret == 1){
+            fprintf(stderr, "Skipping malformed row %d of fracdata.dat\n", row);
+            continue;
+        }
+        snprintf(filepath, FILENAMELEN, "%sfrac%d.png", argv[1], frac.fracnum);
+        if (writer == NULL){
+            if (ReadPNGsize(filepath, &width, &height) != 0){
+                fprintf(stderr, "Failed to read %s\n", filepath);
+                exit(1);
+            }
+            resizefrac(&frac, width, height);
+            writer = newshardwriter(argv[1], "", pershard, coloured ? SHARDBITS : SHARDBYTES, width, height);
+        }
+        if (ReadPNGpixels(filepath, frac.bm, frac.width, frac.height, frac.numfuncs) != 0){
+            fprintf(stderr, "Failed to read %s\n", filepath);
+            exit(1);
+        }
+        shardappend(writer, &frac, frac.bm);
+        numdone++;
+    }
+    if (writer != NULL) closeshardwriter(writer);
+    freefrac(&frac);
+    fclose(fp);
+    fprintf(stdout, "Converted %d fractals\n", numdone);
+    exit(0);
+}
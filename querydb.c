@@ -0,0 +1,67 @@
+/* FILE NAME: querydb.c
+ *
+ * This file searches the binary database of a directory 
+ * made by generatedata (see fracdb.c). It prints the ids of
+ * the fractals matching a query, how many there are, or 
+ * their rows as they would be in fracdata.dat, so with an 
+ * empty query -rows exports the whole database as text.
+ *
+ * usage: ./querydb directory/ [-ids | -count | -rows] [query]
+ * eg.    ./querydb Test/ -count "dimension > 1.4 AND contains functype 10"
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Fractals.h"
+#include "fracdb.h"
+
+int main(int argc, char *argv[]){
+    int arg = 2;
+    char *mode = "-ids", *query = "";
+    long long i, numselected = 0;
+    unsigned char *selected;
+    struct FracDB *db;
+
+    if (argc < 2 || argc > 4){
+        fprintf(stderr, "usage: %s directory/ [-ids | -count | -rows] [query]\n", argv[0]);
+        exit(1);
+    }
+    if (arg < argc && argv[arg][0] == '-') mode = argv[arg++];
+    if (arg < argc) query = argv[arg++];
+    if (arg < argc || (strcmp(mode, "-ids") != 0 && strcmp(mode, "-count") != 0 && strcmp(mode, "-rows") != 0)){
+        fprintf(stderr, "usage: %s directory/ [-ids | -count | -rows] [query]\n", argv[0]);
+        exit(1);
+    }
+    if ((db = opendb(argv[1])) == NULL){
+        fprintf(stderr, "Error, there is no database in %s\n", argv[1]);
+        exit(1);
+    }
+    if (strcmp(mode, "-count") == 0 && query[0] == '\0'){
+        fprintf(stdout, "%lld\n", db -> count);
+        closedb(db);
+        exit(0);
+    }
+    if ((selected = (unsigned char *)malloc(db -> count + 1)) == NULL){
+        fprintf(stderr, "Malloc failed (querydb)\n");
+        exit(1);
+    }
+    if (dbquery(db, query, selected) != 0){
+        fprintf(stderr, "Error, can't understand the query: %s\n"
+                        "Conditions are 'column op value' or 'contains functype t', joined by AND,\n"
+                        "where op is one of < <= > >= = != and column is one of id, numfuncs,\n"
+                        "numpoints, numb, avgx, avgy, stddevx, stddevy, dimension, dimfit,\n"
+                        "contraction, lipschitz\n", query);
+        exit(1);
+    }
+    for (i = 0; i < db -> count; i++){
+        if (selected[i] == 0) continue;
+        numselected++;
+        if (strcmp(mode, "-ids") == 0) fprintf(stdout, "%d\n", ((int *)db -> cols[DBID])[i]);
+        else if (strcmp(mode, "-rows") == 0) dbwriterow(stdout, db, i);
+    }
+    if (strcmp(mode, "-count") == 0) fprintf(stdout, "%lld\n", numselected);
+    free(selected);
+    closedb(db);
+    exit(0);
+}
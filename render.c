@@ -0,0 +1,225 @@
+/* FILE NAME: render.c
+ *
+ * This file contains the parallel path for plotting the points 
+ * of a single fractal, for fractals with so many points that 
+ * generating them on one thread takes too long (see generatefrac).
+ *
+ * The points are split into chunks of RENDERCHUNK points. Each 
+ * chunk is an orbit of its own, starting at a random point with 
+ * its own burn-in and its own random number stream (derived from 
+ * the fractal's generator and the chunk number), so every chunk 
+ * plots the same points whichever thread plots it. Threads take 
+ * the next chunk that hasn't been started until there are none 
+ * left, so faster threads simply do more chunks. Each thread plots 
+ * into its own pixel map, views and density histogram, which are
+ * merged into the fractal's once every chunk is done, so plotting 
+ * never has to lock anything.
+ *
+ * Each thread marks the pixels it draws with the chunk that drew 
+ * them, and since a thread takes its chunks in increasing order, the
+ * merge keeps the colour from the highest chunk that drew each pixel,
+ * as if the chunks had been plotted one after the other. So the 
+ * image, the stats, and the density counts don't depend on the 
+ * number of threads or on which thread plotted which chunk.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "Fractals.h"
+#include "density.h"
+#include "render.h"
+#include "fanout.h"
+
+void initworker(struct Fractal *worker, struct Fractal *frac){
+    /* This function sets up worker as a copy of frac to plot chunks 
+     * of its points into. The worker shares the genome and compiled 
+     * maps of frac, but has its own pixel map, views, stats, 
+     * density histogram, and the chunk that last drew each pixel.
+     */
+    *worker = *frac;
+    worker -> bm = NULL;
+    worker -> boxes = NULL;
+    worker -> density = NULL;
+    worker -> set = NULL;
+    worker -> fan = NULL;
+    worker -> views = NULL;
+    worker -> numviews = 0;
+    worker -> xs = worker -> ys = NULL;
+    worker -> colours = NULL;
+    worker -> keeppoints = 0;
+    worker -> adaptive = 0;
+    worker -> pilot = NULL;
+    resizefrac(worker, frac -> width, frac -> height);
+    if ((worker -> lastchunk = (int *)malloc((size_t)frac -> width*frac -> height*sizeof(int))) == NULL){
+        fprintf(stderr, "Malloc failed (initworker)\n");
+        exit(1);
+    }
+    for (int v = 0; v < frac -> numviews; v++){
+        addview(worker, frac -> views[v].width, frac -> views[v].height, frac -> views[v].window);
+        if ((worker -> views[v].lastchunk = (int *)malloc((size_t)frac -> views[v].width*frac -> views[v].height*sizeof(int))) == NULL){
+            fprintf(stderr, "Malloc failed (initworker)\n");
+            exit(1);
+        }
+    }
+    if (frac -> density != NULL){
+        worker -> density = newdensity(frac -> width, frac -> height, frac -> density -> bits);
+    }
+    if ((worker -> stats.funccounts = (int *)calloc(frac -> numfuncs, sizeof(int))) == NULL){
+        fprintf(stderr, "Malloc failed (initworker)\n");
+        exit(1);
+    }
+    clearmatrix(worker);
+    return;
+}
+
+void freeworker(struct Fractal *worker){
+    /* This function frees what initworker allocated, leaving the
+     * genome and maps shared with the fractal
+     */
+    free(worker -> bm);
+    free(worker -> boxes);
+    free(worker -> lastchunk);
+    for (int v = 0; v < worker -> numviews; v++){
+        free(worker -> views[v].bm);
+        free(worker -> views[v].lastchunk);
+    }
+    free(worker -> views);
+    freedensity(worker -> density);
+    freefanout(worker -> fan);
+    free(worker -> stats.funccounts);
+    return;
+}
+
+void * renderworker(void *arg){
+    /* This function is run by each thread of renderparallel. It plots
+     * chunks of points into its own worker until there are none left.
+     */
+    struct RenderPool *pool = (struct RenderPool *)arg;
+    struct Fractal *worker;
+    int t, chunk;
+    double max;
+    pthread_mutex_lock(&(pool -> lock));
+    t = pool -> numstarted++;
+    pthread_mutex_unlock(&(pool -> lock));
+    worker = &(pool -> workers[t]);
+    pool -> maxes[t] = 0;
+    while (1){
+        pthread_mutex_lock(&(pool -> lock));
+        chunk = pool -> nextchunk++;
+        pthread_mutex_unlock(&(pool -> lock));
+        if (chunk >= pool -> numchunks) break;
+        rngseed(&(worker -> rng), pool -> seed, chunk);
+        worker -> chunk = chunk;
+        for (int v = 0; v < worker -> numviews; v++) worker -> views[v].chunk = chunk;
+        worker -> numpoints = pool -> chunksize;
+        if (chunk == pool -> numchunks - 1){
+            worker -> numpoints = pool -> frac -> numpoints - chunk*pool -> chunksize;
+        }
+        if (worker -> engine == ENGINEFANOUT) max = generatefanout(worker);
+        else if (worker -> numwalkers > 1) max = generatewalkers(worker);
+        else max = generatepoints(worker);
+        if (max > pool -> maxes[t]) pool -> maxes[t] = max;
+    }
+    return NULL;
+}
+
+void mergepixels(unsigned char *bm, int *lastchunk, unsigned char *from, int *fromchunk, size_t size){
+    /* This function merges the pixels of the image from into bm, where
+     * lastchunk and fromchunk are the chunks that last drew each pixel,
+     * keeping the colour of whichever chunk is higher
+     */
+    for (size_t i = 0; i < size; i++){
+        if (from[i] != BLANKPIXEL && (bm[i] == BLANKPIXEL || fromchunk[i] > lastchunk[i])){
+            bm[i] = from[i];
+            lastchunk[i] = fromchunk[i];
+        }
+    }
+    return;
+}
+
+void mergeworkers(struct Fractal *frac, struct Fractal *workers, int numworkers){
+    /* This function puts the pixel maps, views and density histograms
+     * of the workers together into those of frac, and works out the 
+     * stats of the merged pixel map. The pixels are merged into the 
+     * first worker (see mergepixels) and then copied to frac.
+     */
+    int t, v;
+    size_t size = (size_t)frac -> width*frac -> height;
+    struct FracView *view;
+    struct FracDensity **densities;
+    for (t = 1; t < numworkers; t++){
+        mergepixels(workers[0].bm, workers[0].lastchunk, workers[t].bm, workers[t].lastchunk, size);
+    }
+    memcpy(frac -> bm, workers[0].bm, size);
+    for (v = 0; v < frac -> numviews; v++){
+        view = &(frac -> views[v]);
+        size = (size_t)view -> width*view -> height;
+        for (t = 1; t < numworkers; t++){
+            mergepixels(workers[0].views[v].bm, workers[0].views[v].lastchunk, 
+                        workers[t].views[v].bm, workers[t].views[v].lastchunk, size);
+        }
+        memcpy(view -> bm, workers[0].views[v].bm, size);
+    }
+    countmatrix(frac);
+    if (frac -> density != NULL){
+        if ((densities = (struct FracDensity **)malloc((numworkers + 1)*sizeof(struct FracDensity *))) == NULL){
+            fprintf(stderr, "Malloc failed (mergeworkers)\n");
+            exit(1);
+        }
+        densities[0] = frac -> density;
+        for (t = 0; t < numworkers; t++) densities[t + 1] = workers[t].density;
+        mergedensities(densities, numworkers + 1);
+        free(densities);
+    }
+    return;
+}
+
+double renderparallel(struct Fractal *frac){
+    /* This function plots the points of a fractal on frac -> renderthreads
+     * threads (see the top of this file) instead of generatepoints or 
+     * generatewalkers. The pixel map must have been cleared (see 
+     * clearmatrix). Every point is plotted, adaptive stopping isn't
+     * used. It returns the largest coordinate of any point, like 
+     * generatepoints.
+     */
+    int t, numthreads = frac -> renderthreads;
+    double max = 0;
+    struct RenderPool pool;
+    pthread_t *threads;
+    pool.frac = frac;
+    pool.seed = rngnext(&(frac -> rng));
+    pool.chunksize = RENDERCHUNK;
+    pool.numchunks = frac -> numpoints/RENDERCHUNK + (frac -> numpoints % RENDERCHUNK != 0);
+    pool.nextchunk = 0;
+    pool.numstarted = 0;
+    if (numthreads > pool.numchunks) numthreads = pool.numchunks;
+    if (((pool.workers = (struct Fractal *)malloc(numthreads * sizeof(struct Fractal))) == NULL)||
+        ((pool.maxes = (double *)malloc(numthreads * sizeof(double))) == NULL)||
+        ((threads = (pthread_t *)malloc(numthreads * sizeof(pthread_t))) == NULL)){
+        fprintf(stderr, "Malloc failed (renderparallel)\n");
+        exit(1);
+    }
+    for (t = 0; t < numthreads; t++) initworker(&(pool.workers[t]), frac);
+    pthread_mutex_init(&(pool.lock), NULL);
+    for (t = 0; t < numthreads; t++){
+        if (pthread_create(&(threads[t]), NULL, renderworker, &pool) != 0){
+            fprintf(stderr, "Failed to create thread (renderparallel)\n");
+            exit(1);
+        }
+    }
+    for (t = 0; t < numthreads; t++){
+        pthread_join(threads[t], NULL);
+        if (pool.maxes[t] > max) max = pool.maxes[t];
+    }
+    pthread_mutex_destroy(&(pool.lock));
+    mergeworkers(frac, pool.workers, numthreads);
+    frac -> pointsused = frac -> numpoints;
+    for (t = 0; t < numthreads; t++) freeworker(&(pool.workers[t]));
+    free(pool.workers);
+    free(pool.maxes);
+    free(threads);
+    return max;
+}
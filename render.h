@@ -0,0 +1,25 @@
+/* FILE NAME: render.h */
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+struct Fractal;
+struct RenderPool{
+        /* The state shared by the threads plotting one fractal, see 
+         * renderparallel. Chunk c of chunksize points is plotted by 
+         * whichever thread takes it next, into that thread's own copy
+         * of the fractal, workers[t].
+         */
+        struct Fractal *frac, *workers;
+        uint64_t seed;
+        int numchunks, chunksize, nextchunk, numstarted;
+        double *maxes;
+        pthread_mutex_t lock;
+};
+
+void initworker(struct Fractal *worker, struct Fractal *frac);
+void freeworker(struct Fractal *worker);
+void * renderworker(void *arg);
+void mergepixels(unsigned char *bm, int *lastchunk, unsigned char *from, int *fromchunk, size_t size);
+void mergeworkers(struct Fractal *frac, struct Fractal *workers, int numworkers);
+double renderparallel(struct Fractal *frac);
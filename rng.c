@@ -0,0 +1,59 @@
+/* FILE NAME: rng.c
+ *
+ * This file contains the random number generator used 
+ * to generate fractals in place of rand(). Each fractal
+ * has its own generator (xoshiro256**) whose state is
+ * derived from a global seed and the fractal's number, 
+ * so any fractal can be generated again exactly, and 
+ * generating fractals on different threads gives the 
+ * same fractals as generating them one at a time.
+ */
+
+#include <stdint.h>
+#include "rng.h"
+
+uint64_t splitmix64(uint64_t *x){
+    /* This function is used to turn seeds into generator states */
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void rngseed(struct FracRNG *rng, uint64_t seed, uint64_t stream){
+    /* This function seeds a generator from a global seed and
+     * a stream number (eg. the fractal number). Different
+     * streams of the same seed give unrelated sequences.
+     */
+    uint64_t x = seed;
+    x = splitmix64(&x) ^ (stream * 0xD1B54A32D192ED03ULL);
+    for (int i = 0; i < 4; i++){
+        rng -> s[i] = splitmix64(&x);
+    }
+    return;
+}
+
+uint64_t rngnext(struct FracRNG *rng){
+    /* This function returns the next 64 random bits (xoshiro256**) */
+    uint64_t *s = rng -> s;
+    uint64_t result = s[1] * 5;
+    result = ((result << 7) | (result >> 57)) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+    return result;
+}
+
+double rnguniform(struct FracRNG *rng){
+    /* This function returns a random double in [0, 1) */
+    return (double)(rngnext(rng) >> 11) * (1.0/9007199254740992.0);
+}
+
+int rngint(struct FracRNG *rng, int n){
+    /* This function returns a random integer in [0, n) */
+    return (int)(((rngnext(rng) >> 32) * (uint64_t)n) >> 32);
+}
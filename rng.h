@@ -0,0 +1,11 @@
+/* FILE NAME: rng.h */
+#include <stdint.h>
+
+struct FracRNG{
+        uint64_t s[4];
+};
+
+void rngseed(struct FracRNG *rng, uint64_t seed, uint64_t stream);
+uint64_t rngnext(struct FracRNG *rng);
+double rnguniform(struct FracRNG *rng);
+int rngint(struct FracRNG *rng, int n);
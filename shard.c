@@ -0,0 +1,289 @@
+/* FILE NAME: shard.c
+ *
+ * This file contains functions to write and read shards: 
+ * single files holding the images, stats and genomes of
+ * many fractals, so that a database doesn't need a png
+ * for every fractal. A shard is laid out as
+ *
+ *      header | image 0 | image 1 | ... | index | stats | genome index | genomes
+ *
+ * where every image has the same size, so a reader can 
+ * mmap a shard and use image i in place (see openshard).
+ * Images are written as fractals are finished, and the
+ * rest is written once the shard is full or the run ends.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Fractals.h"
+#include "PNGio.h"
+#include "shard.h"
+
+struct ShardWriter * newshardwriter(char *dirname, char *suffix, int pershard, int encoding, int width, int height){
+    /* This function sets up writing shards of pershard width x height 
+     * images each to the directory dirname, in the given encoding 
+     * (SHARDBITS, SHARDBYTES or SHARDGRAY16). A shard is named after the number 
+     * of its first fractal followed by suffix, eg. shard1000.frs, or
+     * shard1000_view1.frs with the suffix _view1.
+     */
+    struct ShardWriter *writer;
+    if (((writer = (struct ShardWriter *)malloc(sizeof(struct ShardWriter))) == NULL)||
+        ((writer -> image = (unsigned char *)malloc((encoding == SHARDGRAY16 ? 2 : 1)*(size_t)height*width*sizeof(unsigned char))) == NULL)||
+        ((writer -> genomeindex = (uint64_t *)malloc((pershard + 1)*sizeof(uint64_t))) == NULL)||
+        ((writer -> stats = (struct ShardStats *)malloc(pershard*sizeof(struct ShardStats))) == NULL)){
+        fprintf(stderr, "Malloc failed (newshardwriter)\n");
+        exit(1);
+    }
+    writer -> genomecap = 16*pershard;
+    if ((writer -> genomes = (double *)malloc(writer -> genomecap*sizeof(double))) == NULL){
+        fprintf(stderr, "Malloc failed (newshardwriter)\n");
+        exit(1);
+    }
+    writer -> dirname = dirname;
+    snprintf(writer -> suffix, 16, "%s", suffix);
+    writer -> width = width;
+    writer -> height = height;
+    writer -> pershard = pershard;
+    writer -> encoding = encoding;
+    writer -> count = 0;
+    writer -> genomelen = 0;
+    writer -> fp = NULL;
+    return writer;
+}
+
+uint64_t shardimagesize(struct ShardWriter *writer){
+    /* This function returns the size of one image in bytes */
+    if (writer -> encoding == SHARDBITS) return (uint64_t)writer -> height*PACKEDROW(writer -> width);
+    if (writer -> encoding == SHARDGRAY16) return 2*(uint64_t)writer -> height*writer -> width;
+    return (uint64_t)writer -> height*writer -> width;
+}
+
+void writeshardheader(struct ShardWriter *writer, struct ShardHeader *header){
+    /* This function writes the header at the start of the current shard */
+    if (fseek(writer -> fp, 0, SEEK_SET) != 0 || 
+        fwrite(header, sizeof(struct ShardHeader), 1, writer -> fp) != 1){
+        fprintf(stderr, "Failed to write shard header (writeshardheader)\n");
+        exit(1);
+    }
+    return;
+}
+
+void shardappend(struct ShardWriter *writer, struct Fractal *frac, unsigned char *bm){
+    /* This function adds a finished fractal to the current shard,
+     * starting a new one if there isn't one. bm is its pixel map, one
+     * of its views (see addview) or its density image, of the writer's 
+     * size and encoding. Fractals 
+     * have to be appended in order of their number.
+     */
+    char filename[FILENAMELEN];
+    struct ShardHeader header;
+    struct ShardStats *stats;
+    uint64_t size = shardimagesize(writer);
+    if (writer -> fp == NULL){
+        snprintf(filename, FILENAMELEN, "%sshard%d%s.frs", writer -> dirname, frac -> fracnum, writer -> suffix);
+        if ((writer -> fp = fopen(filename, "wb")) == NULL){
+            fprintf(stderr, "Failed to open file (shardappend): %s\n", filename);
+            exit(1);
+        }
+        memset(&header, 0, sizeof(struct ShardHeader));
+        writeshardheader(writer, &header);
+        writer -> count = 0;
+        writer -> genomelen = 0;
+        writer -> genomeindex[0] = 0;
+    }
+    if (writer -> encoding == SHARDBITS) packbitmap(bm, writer -> width, writer -> height, writer -> image);
+    else memcpy(writer -> image, bm, size);
+    if (fwrite(writer -> image, 1, size, writer -> fp) != size){
+        fprintf(stderr, "Failed to write image (shardappend)\n");
+        exit(1);
+    }
+
+    stats = &(writer -> stats[writer -> count]);
+    stats -> fracnum    = frac -> fracnum;
+    stats -> numfuncs   = frac -> numfuncs;
+    stats -> pointsused = frac -> pointsused;
+    stats -> numb       = frac -> numb;
+    stats -> avgx       = frac -> avgx;
+    stats -> avgy       = frac -> avgy;
+    stats -> stddevx    = frac -> stddevx;
+    stats -> stddevy    = frac -> stddevy;
+    stats -> dimension  = frac -> dimension;
+    stats -> dimfit     = frac -> dimfit;
+    if (writer -> genomelen + 14*frac -> numfuncs > writer -> genomecap){
+        writer -> genomecap = 2*writer -> genomecap + 14*frac -> numfuncs;
+        if ((writer -> genomes = (double *)realloc(writer -> genomes, writer -> genomecap*sizeof(double))) == NULL){
+            fprintf(stderr, "Malloc failed (shardappend)\n");
+            exit(1);
+        }
+    }
+    writer -> genomelen += packgenome(frac -> numfuncs, frac -> genome, &(writer -> genomes[writer -> genomelen]));
+    writer -> count++;
+    writer -> genomeindex[writer -> count] = writer -> genomelen;
+    if (writer -> count == writer -> pershard) finishshard(writer);
+    return;
+}
+
+void shardwrite(struct ShardWriter *writer, void *vals, size_t size, size_t num){
+    /* This function writes num values of size bytes to the current 
+     * shard, exiting if they can't all be written
+     */
+    if (fwrite(vals, size, num, writer -> fp) != num){
+        fprintf(stderr, "Failed to write shard (shardwrite)\n");
+        exit(1);
+    }
+    return;
+}
+
+void finishshard(struct ShardWriter *writer){
+    /* This function writes the index, stats and genomes at the end of
+     * the current shard, fills in its header and closes it. Each section
+     * starts on a multiple of 8 bytes so that it can be used in place.
+     * The header is written last, so a shard with a valid header is 
+     * complete.
+     */
+    struct ShardHeader header;
+    uint64_t i, offset, size = shardimagesize(writer);
+    uint64_t pad = 0;
+    if (writer -> fp == NULL) return;
+    memcpy(header.magic, "FRACSHRD", 8);
+    header.version  = SHARDVERSION;
+    header.width    = writer -> width;
+    header.height   = writer -> height;
+    header.encoding = writer -> encoding;
+    header.imagesize = size;
+    header.count    = writer -> count;
+    offset = sizeof(struct ShardHeader) + writer -> count*size;
+    shardwrite(writer, &pad, 1, (8 - offset%8)%8);
+    offset += (8 - offset%8)%8;
+
+    header.indexoffset = offset;
+    for (i = 0; i <= (uint64_t)writer -> count; i++){
+        uint64_t imageoffset = sizeof(struct ShardHeader) + i*size;
+        shardwrite(writer, &imageoffset, sizeof(uint64_t), 1);
+    }
+    header.statsoffset = header.indexoffset + (writer -> count + 1)*sizeof(uint64_t);
+    shardwrite(writer, writer -> stats, sizeof(struct ShardStats), writer -> count);
+    header.genomeindexoffset = header.statsoffset + writer -> count*sizeof(struct ShardStats);
+    shardwrite(writer, writer -> genomeindex, sizeof(uint64_t), writer -> count + 1);
+    header.genomeoffset = header.genomeindexoffset + (writer -> count + 1)*sizeof(uint64_t);
+    shardwrite(writer, writer -> genomes, sizeof(double), writer -> genomelen);
+    writeshardheader(writer, &header);
+    if (fclose(writer -> fp) != 0){
+        fprintf(stderr, "Failed to write shard (finishshard)\n");
+        exit(1);
+    }
+    writer -> fp = NULL;
+    return;
+}
+
+void closeshardwriter(struct ShardWriter *writer){
+    /* This function finishes the last shard, which may not be full,
+     * and frees the writer
+     */
+    finishshard(writer);
+    free(writer -> image);
+    free(writer -> genomeindex);
+    free(writer -> stats);
+    free(writer -> genomes);
+    free(writer);
+    return;
+}
+
+int shardsection(struct Shard *shard, uint64_t offset, uint64_t size, uint64_t num){
+    /* This function returns 1 if num values of size bytes starting 
+     * offset bytes into a mapped shard lie inside it, else 0. offset
+     * has to be past the header and, for values of more than one byte,
+     * a multiple of 8.
+     */
+    if (offset < sizeof(struct ShardHeader) || offset > shard -> size) return 0;
+    if (size > 1 && offset%8 != 0) return 0;
+    if (size > 0 && num > (shard -> size - offset)/size) return 0;
+    return 1;
+}
+
+struct Shard * openshard(char *filename){
+    /* This function maps a shard file into memory, read only. NULL is 
+     * returned if the file can't be opened or isn't a finished shard,
+     * including when any image, stats or genome would lie outside it.
+     * Nothing is copied: shardimage, shardstats and shardgenome return
+     * pointers into the mapping, which are valid until closeshard.
+     */
+    int fd;
+    struct stat st;
+    struct Shard *shard;
+    struct ShardHeader *header;
+    if ((fd = open(filename, O_RDONLY)) < 0) return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(struct ShardHeader)){
+        close(fd);
+        return NULL;
+    }
+    if ((shard = (struct Shard *)malloc(sizeof(struct Shard))) == NULL){
+        fprintf(stderr, "Malloc failed (openshard)\n");
+        exit(1);
+    }
+    shard -> size = st.st_size;
+    shard -> map = (unsigned char *)mmap(NULL, shard -> size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shard -> map == MAP_FAILED){
+        free(shard);
+        return NULL;
+    }
+    header = shard -> header = (struct ShardHeader *)shard -> map;
+    if (memcmp(header -> magic, "FRACSHRD", 8) != 0 || header -> version != SHARDVERSION ||
+        !shardsection(shard, header -> indexoffset, sizeof(uint64_t), header -> count + 1) ||
+        !shardsection(shard, header -> statsoffset, sizeof(struct ShardStats), header -> count) ||
+        !shardsection(shard, header -> genomeindexoffset, sizeof(uint64_t), header -> count + 1) ||
+        !shardsection(shard, header -> genomeoffset, sizeof(double), 0)){
+        closeshard(shard);
+        return NULL;
+    }
+    shard -> index       = (uint64_t *)(shard -> map + header -> indexoffset);
+    shard -> stats       = (struct ShardStats *)(shard -> map + header -> statsoffset);
+    shard -> genomeindex = (uint64_t *)(shard -> map + header -> genomeindexoffset);
+    shard -> genomes     = (double *)(shard -> map + header -> genomeoffset);
+    for (uint64_t i = 0; i < header -> count; i++){
+        if (!shardsection(shard, shard -> index[i], 1, header -> imagesize) ||
+            shard -> genomeindex[i] > shard -> genomeindex[i+1]){
+            closeshard(shard);
+            return NULL;
+        }
+    }
+    if (!shardsection(shard, header -> genomeoffset, sizeof(double), shard -> genomeindex[header -> count])){
+        closeshard(shard);
+        return NULL;
+    }
+    return shard;
+}
+
+void closeshard(struct Shard *shard){
+    /* This function unmaps a shard opened with openshard */
+    munmap(shard -> map, shard -> size);
+    free(shard);
+    return;
+}
+
+unsigned char * shardimage(struct Shard *shard, uint64_t i){
+    /* This function returns image i of a shard, header -> imagesize 
+     * bytes in the shard's encoding
+     */
+    return shard -> map + shard -> index[i];
+}
+
+struct ShardStats * shardstats(struct Shard *shard, uint64_t i){
+    /* This function returns the stats of fractal i of a shard */
+    return &(shard -> stats[i]);
+}
+
+double * shardgenome(struct Shard *shard, uint64_t i, int *len){
+    /* This function returns the genome of fractal i of a shard and 
+     * sets len to its length. It can be turned back into a genome 
+     * with unpackgenome.
+     */
+    *len = shard -> genomeindex[i+1] - shard -> genomeindex[i];
+    return &(shard -> genomes[shard -> genomeindex[i]]);
+}
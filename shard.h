@@ -0,0 +1,62 @@
+/* FILE NAME: shard.h */
+#include <stdint.h>
+
+#define SHARDBITS 0     //images are packed bitmaps, PACKEDROW(width) bytes per row (see packbitmap)
+#define SHARDBYTES 1    //images are pixel maps, one byte per pixel (see Fractals.h),
+                        //or 8 bit density images (see tonemapdensity)
+#define SHARDGRAY16 2   //images are 16 bit density images, most significant byte first
+#define SHARDVERSION 1
+
+struct Fractal;
+struct ShardHeader{
+        /* The start of every shard file. The images start right after
+         * the header, and the offsets are from the start of the file.
+         */
+        char magic[8];                  //"FRACSHRD"
+        uint32_t version, width, height, encoding;
+        uint64_t imagesize, count;
+        uint64_t indexoffset;           //count+1 image offsets
+        uint64_t statsoffset;           //count ShardStats
+        uint64_t genomeindexoffset;     //count+1 offsets into the genomes, in doubles
+        uint64_t genomeoffset;          //genomes as made by packgenome
+};
+
+struct ShardStats{
+        int32_t fracnum, numfuncs, pointsused, numb;
+        double avgx, avgy, stddevx, stddevy, dimension, dimfit;
+};
+
+struct ShardWriter{
+        /* A shard file being written, see newshardwriter. The stats and
+         * genomes of its fractals are kept until the shard is finished.
+         */
+        char *dirname, suffix[16];
+        int pershard, encoding, width, height, count, genomelen, genomecap;
+        FILE *fp;
+        unsigned char *image;
+        uint64_t *genomeindex;
+        struct ShardStats *stats;
+        double *genomes;
+};
+
+struct Shard{
+        /* A shard file mapped into memory, see openshard */
+        unsigned char *map;
+        size_t size;
+        struct ShardHeader *header;
+        uint64_t *index, *genomeindex;
+        struct ShardStats *stats;
+        double *genomes;
+};
+
+struct ShardWriter * newshardwriter(char *dirname, char *suffix, int pershard, int encoding, int width, int height);
+void shardappend(struct ShardWriter *writer, struct Fractal *frac, unsigned char *bm);
+void shardwrite(struct ShardWriter *writer, void *vals, size_t size, size_t num);
+void finishshard(struct ShardWriter *writer);
+void closeshardwriter(struct ShardWriter *writer);
+int shardsection(struct Shard *shard, uint64_t offset, uint64_t size, uint64_t num);
+struct Shard * openshard(char *filename);
+void closeshard(struct Shard *shard);
+unsigned char * shardimage(struct Shard *shard, uint64_t i);
+struct ShardStats * shardstats(struct Shard *shard, uint64_t i);
+double * shardgenome(struct Shard *shard, uint64_t i, int *len);
@@ -0,0 +1,202 @@
+/* FILE NAME: vecmath.c
+ *
+ * This file contains versions of sin, cos, tanh and exp
+ * that work on whole vectors of values at once. The 
+ * loops have no branches or calls in them so that 
+ * the compiler can vectorize them (SSE2, AVX2 or 
+ * AVX-512 depending on what it is allowed to use),
+ * while still being plain C on any other machine. 
+ * They are accurate to within a few units in the 
+ * last place, like libm, for the arguments used by
+ * the IFS maps, and fall back to libm for the rest.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include "vecmath.h"
+
+#define ROUNDER  6755399441055744.0          // 1.5*2^52, adding it rounds to an integer
+#define INVPIO2  6.36619772367581382433e-01  // 2/pi
+#define PIO2_1   1.57079632673412561417e+00  // first 33 bits of pi/2
+#define PIO2_2   6.07710050630396597660e-11  // next 33 bits of pi/2
+#define PIO2_2T  2.02226624879595063154e-21  // pi/2 - (PIO2_1 + PIO2_2)
+#define LOG2E    1.44269504088896338700e+00
+#define LN2HI    6.93147180369123816490e-01
+#define LN2LO    1.90821492927058770002e-10
+#define REDUCEMAX 1e6                        // largest argument reduced without libm
+
+void vsinphase(int n, double *out, const double *in, int phase){
+    /* This function computes out[i] = sin(in[i] + phase*pi/2), so
+     * phase 0 gives sin and phase 1 gives cos. The argument is
+     * reduced to r in [-pi/4, pi/4] with x = k*pi/2 + r, then the
+     * sin or cos polynomial of r is used depending on (k + phase) mod 4 
+     * (the polynomials are the ones used by fdlibm)
+     */
+    int i;
+    double x, k, q, r, r2, s, c, v;
+    for (i = 0; i < n; i++){
+        x  = in[i];
+        k  = (x * INVPIO2 + ROUNDER) - ROUNDER;
+        r  = ((x - k*PIO2_1) - k*PIO2_2) - k*PIO2_2T;
+        k += phase;
+        q  = k - 4.0*((k*0.25 + ROUNDER) - ROUNDER);     // k mod 4 in [-2, 2]
+        r2 = r*r;
+        s  = r + r*r2*(-1.66666666666666324348e-01 + r2*(8.33333333332248946124e-03
+                 + r2*(-1.98412698298579493134e-04 + r2*(2.75573137070700676789e-06
+                 + r2*(-2.50507602534068634195e-08 + r2*1.58969099521155010221e-10)))));
+        c  = 1.0 - 0.5*r2 + r2*r2*(4.16666666666666019037e-02 + r2*(-1.38888888888741095749e-03
+                 + r2*(2.48015872894767294178e-05 + r2*(-2.75573143513906633035e-07
+                 + r2*(2.08757232129817482790e-09 + r2*-1.13596475577881948265e-11)))));
+        v  = (fabs(q) == 1.0) ? c : s;
+        v  = (q == -1.0) ? -v : v;
+        out[i] = (fabs(q) == 2.0) ? -v : v;
+    }
+    for (i = 0; i < n; i++){
+        if (!(fabs(in[i]) < REDUCEMAX)) out[i] = phase ? cos(in[i]) : sin(in[i]);
+    }
+    return;
+}
+
+void vsin(int n, double *out, const double *in){
+    /* This function computes out[i] = sin(in[i]), see vsinphase */
+    vsinphase(n, out, in, 0);
+    return;
+}
+
+void vcos(int n, double *out, const double *in){
+    /* This function computes out[i] = cos(in[i]), see vsinphase */
+    vsinphase(n, out, in, 1);
+    return;
+}
+
+void vexp(int n, double *out, const double *in){
+    /* This function computes out[i] = exp(in[i]) for -700 < in[i] < 700,
+     * arguments outside of that range are clamped. With x = k*ln2 + r, 
+     * exp(x) = 2^k * exp(r) where |r| <= ln2/2 and exp(r) is a 
+     * Taylor polynomial. 2^k is built directly in the exponent bits,
+     * k being read out of the low bits of k + ROUNDER.
+     */
+    int i;
+    double x, k, kr, r, p, scale;
+    uint64_t bits, rounderbits;
+    kr = ROUNDER;
+    memcpy(&rounderbits, &kr, sizeof(double));
+    for (i = 0; i < n; i++){
+        x  = in[i];
+        x  = (x < -700.0) ? -700.0 : x;
+        x  = (x >  700.0) ?  700.0 : x;
+        kr = x * LOG2E + ROUNDER;
+        k  = kr - ROUNDER;
+        r = (x - k*LN2HI) - k*LN2LO;
+        p = 1.0 + r*(1.0 + r*(1.0/2 + r*(1.0/6 + r*(1.0/24 + r*(1.0/120 + r*(1.0/720
+              + r*(1.0/5040 + r*(1.0/40320 + r*(1.0/362880 + r*(1.0/3628800
+              + r*(1.0/39916800 + r*(1.0/479001600))))))))))));
+        memcpy(&bits, &kr, sizeof(double));
+        bits = (bits - rounderbits + 1023) << 52;
+        memcpy(&scale, &bits, sizeof(double));
+        out[i] = p * scale;
+    }
+    return;
+}
+
+void vtanh(int n, double *out, const double *in){
+    /* This function computes out[i] = tanh(in[i]) using 
+     * tanh(x) = sign(x) (1 - e^(-2|x|))/(1 + e^(-2|x|))
+     * NOTE: out is used as scratch space, so it must not
+     * be the same as in
+     */
+    int i;
+    double t;
+    for (i = 0; i < n; i++){
+        out[i] = -2.0*fabs(in[i]);
+    }
+    vexp(n, out, out);
+    for (i = 0; i < n; i++){
+        t = (1.0 - out[i])/(1.0 + out[i]);
+        out[i] = (in[i] < 0) ? -t : t;
+    }
+    for (i = 0; i < n; i++){
+        if (in[i] != in[i]) out[i] = in[i];
+    }
+    return;
+}
+
+/* The fast versions below use shorter polynomials than the ones above.
+ * The IFS maps only use them as a*f(b*x) with |a| < 1, and their 
+ * absolute errors are below FASTMATHERROR, which is far less than a 
+ * pixel at any resolution a fractal is drawn at (a pixel is 0.01 wide
+ * with the default 640x640 image of the -3 to 3 window). Use 
+ * validatekernels() in gendb.c to compare images drawn with them
+ * against images drawn with libm.
+ */
+
+void vsinphasefast(int n, double *out, const double *in, int phase){
+    /* This function is the same as vsinphase, except that r is reduced
+     * with 2 parts of pi/2 and sin(r) and cos(r) are Taylor polynomials
+     * of degree 7 and 8, accurate to 3.2e-7 and 2.5e-8 for |r| <= pi/4
+     */
+    int i;
+    double x, k, q, r, r2, s, c, v;
+    for (i = 0; i < n; i++){
+        x  = in[i];
+        k  = (x * INVPIO2 + ROUNDER) - ROUNDER;
+        r  = (x - k*PIO2_1) - k*PIO2_2;
+        k += phase;
+        q  = k - 4.0*((k*0.25 + ROUNDER) - ROUNDER);
+        r2 = r*r;
+        s  = r + r*r2*(-1.0/6 + r2*(1.0/120 + r2*(-1.0/5040)));
+        c  = 1.0 + r2*(-1.0/2 + r2*(1.0/24 + r2*(-1.0/720 + r2*(1.0/40320))));
+        v  = (fabs(q) == 1.0) ? c : s;
+        v  = (q == -1.0) ? -v : v;
+        out[i] = (fabs(q) == 2.0) ? -v : v;
+    }
+    for (i = 0; i < n; i++){
+        if (!(fabs(in[i]) < REDUCEMAX)) out[i] = phase ? cos(in[i]) : sin(in[i]);
+    }
+    return;
+}
+
+void vsinfast(int n, double *out, const double *in){
+    /* This function computes out[i] = sin(in[i]) to within FASTMATHERROR */
+    vsinphasefast(n, out, in, 0);
+    return;
+}
+
+void vcosfast(int n, double *out, const double *in){
+    /* This function computes out[i] = cos(in[i]) to within FASTMATHERROR */
+    vsinphasefast(n, out, in, 1);
+    return;
+}
+
+void vtanhfast(int n, double *out, const double *in){
+    /* This function computes out[i] = tanh(in[i]) to within FASTMATHERROR
+     * the same way as vtanh, with e = exp(-2|x|) worked out as in vexp but
+     * with a Taylor polynomial of degree 7, which is accurate to 5.2e-9 
+     * relative to e. Since tanh(|x|) = 1 to double precision once |x| > 19,
+     * -2|x| is clamped to -40 so 2^k never underflows.
+     */
+    int i;
+    double x, k, kr, r, p, scale, t;
+    uint64_t bits, rounderbits;
+    kr = ROUNDER;
+    memcpy(&rounderbits, &kr, sizeof(double));
+    for (i = 0; i < n; i++){
+        x  = -2.0*fabs(in[i]);
+        x  = (x < -40.0) ? -40.0 : x;
+        kr = x * LOG2E + ROUNDER;
+        k  = kr - ROUNDER;
+        r  = (x - k*LN2HI) - k*LN2LO;
+        p  = 1.0 + r*(1.0 + r*(1.0/2 + r*(1.0/6 + r*(1.0/24 + r*(1.0/120 + r*(1.0/720 + r*(1.0/5040)))))));
+        memcpy(&bits, &kr, sizeof(double));
+        bits = (bits - rounderbits + 1023) << 52;
+        memcpy(&scale, &bits, sizeof(double));
+        p *= scale;
+        t  = (1.0 - p)/(1.0 + p);
+        out[i] = (in[i] < 0) ? -t : t;
+    }
+    for (i = 0; i < n; i++){
+        if (in[i] != in[i]) out[i] = in[i];
+    }
+    return;
+}
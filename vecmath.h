@@ -0,0 +1,12 @@
+/* FILE NAME: vecmath.h */
+#define FASTMATHERROR 1e-6  //largest error of vsinfast, vcosfast and vtanhfast
+
+void vsinphase(int n, double *out, const double *in, int phase);
+void vsin(int n, double *out, const double *in);
+void vcos(int n, double *out, const double *in);
+void vtanh(int n, double *out, const double *in);
+void vexp(int n, double *out, const double *in);
+void vsinphasefast(int n, double *out, const double *in, int phase);
+void vsinfast(int n, double *out, const double *in);
+void vcosfast(int n, double *out, const double *in);
+void vtanhfast(int n, double *out, const double *in);